@@ -0,0 +1,38 @@
+
+#ifndef FLORENTINO_BASELINE_H
+#define FLORENTINO_BASELINE_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace florentino {
+
+// Results of a previous run, loaded from a file written by JSONResultSink. New
+// results are compared against them to detect performance regressions. Only
+// samples are kept, warm-up runs excluded.
+class Baseline {
+public:
+  // Load the baseline from the given file. An exception is thrown if the file
+  // cannot be read or it is not well-formed.
+  Baseline(const std::string &path);
+
+public:
+  const std::string &path() const { return _path; }
+
+  // Samples, in seconds, of the given interval of the given benchmark. If the
+  // baseline does not contain them, 0 is returned.
+  const std::vector<double> *samples(const std::string &bench,
+                                     const std::string &interval) const;
+
+private:
+  typedef std::map<std::string, std::vector<double> > Intervals;
+
+private:
+  std::string _path;
+  std::map<std::string, Intervals> _benchmarks;
+};
+
+} // End namespace florentino.
+
+#endif // FLORENTINO_BASELINE_H
@@ -2,10 +2,14 @@
 #ifndef FLORENTINO_BENCHMARK_RUNNER_H
 #define FLORENTINO_BENCHMARK_RUNNER_H
 
+#include <florentino/baseline.h>
 #include <florentino/benchmark.h>
 #include <florentino/logstream.h>
+#include <florentino/memory.h>
 #include <florentino/option-parser.h>
+#include <florentino/result-sink.h>
 
+#include <fstream>
 #include <vector>
 
 namespace florentino {
@@ -30,9 +34,33 @@ public:
   static const unsigned DEFAULT_TIMES = 1;
   static const bool DEFAULT_VERBOSE = false;
 
+  // Adaptive repetition: repeat until the relative width of the confidence
+  // interval of the benchmark total time is below a target, or a budget is
+  // exhausted. Disabled by default.
+  static const double DEFAULT_TARGET_WIDTH;
+  static const double DEFAULT_TIME_BUDGET;
+  static const unsigned DEFAULT_MAX_TIMES = 10000;
+  static const unsigned MIN_ADAPTIVE_TIMES = 10;
+
+  // Results are also written in a machine-readable format, if requested.
+  static const std::string DEFAULT_FORMAT;
+  static const std::string DEFAULT_OUTPUT;
+
+  // Results can be compared against a baseline: a regression is detected when
+  // the bandwidth drop of an interval is larger than a threshold, and it is
+  // statistically significant.
+  static const std::string DEFAULT_BASELINE;
+  static const double DEFAULT_THRESHOLD;
+
+  static const bool DEFAULT_COUNTERS = false;
+
+  static const PagePolicy DEFAULT_PAGE_POLICY = SmallPages;
+
+  static const std::string DEFAULT_CLOCK_SOURCE;
+
 public:
   BenchmarkRunner(int argc, char **argv);
-  ~BenchmarkRunner();
+  virtual ~BenchmarkRunner();
 
 private:
   // Do not implement.
@@ -49,9 +77,39 @@ public:
 public:
   std::ostream &log() const { return const_cast<logstream &>(_log); }
 
+  // The kind of pages benchmarks should use for their data.
+  PagePolicy pagePolicy() const { return _pagePolicy; }
+
+private:
+  void repeat(Benchmark &bench);
+  void repeatAdaptive(Benchmark &bench);
+
+  ResultSink *openSink(std::ofstream &file);
+
+  // Compare bench against baseline, returning the number of regressions.
+  unsigned compare(const Benchmark &bench, const Baseline &baseline);
+
+protected:
+  typedef std::vector<Benchmark *>::const_iterator iterator;
+
+protected:
+  iterator begin() const { return _benchmarks.begin(); }
+  iterator end() const { return _benchmarks.end(); }
+
 protected:
   void add(const Option &opt) { _options.add(opt); }
 
+  // Benchmarks can be run at several points of a sweep -- e.g. different data
+  // set sizes. Before running a benchmark at a point, the point is selected by
+  // calling selectPoint, which returns a label for it. The label of the only
+  // point of a run without sweeps should be empty.
+  virtual unsigned pointsCount() const { return 1; }
+  virtual std::string selectPoint(unsigned i) { return ""; }
+
+  // Called once all benchmarks have been run, to print results that involve
+  // more than one benchmark.
+  virtual void summarize() { }
+
 private:
   OptionParser _options;
   logstream _log;
@@ -59,6 +117,21 @@ private:
   unsigned _times;
   bool _verbose;
 
+  double _targetWidth;
+  double _timeBudget;
+  unsigned _maxTimes;
+
+  std::string _format;
+  std::string _output;
+  std::string _command;
+
+  std::string _baseline;
+  double _threshold;
+
+  bool _counters;
+  PagePolicy _pagePolicy;
+  ClockSource::Kind _clockSource;
+
   std::vector<Benchmark *> _benchmarks;
 };
 
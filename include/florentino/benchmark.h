@@ -3,8 +3,12 @@
 #define FLORENTINO_BENCHMARK_H
 
 #include <florentino/clock.h>
+#include <florentino/perf-counters.h>
+#include <florentino/statistics.h>
 
 #include <iostream>
+#include <string>
+#include <vector>
 
 #ifdef HAVE_OPENCL
 
@@ -26,21 +30,86 @@ public:
     ClkEnd
   };
 
+  // Intervals shorter than this many ticks of the clock source are reported
+  // as unreliable.
+  static const unsigned MIN_CLOCK_TICKS = 20;
+
+  // A timed region of the benchmark, going from the time recorded by a clock
+  // to the time recorded by another one.
+  class Interval {
+  public:
+    Interval(const std::string &nm, unsigned from, unsigned to) : _name(nm),
+                                                                  _from(from),
+                                                                  _to(to) { }
+
+  public:
+    const std::string &name() const { return _name; }
+
+    unsigned from() const { return _from; }
+    unsigned to() const { return _to; }
+
+  private:
+    std::string _name;
+
+    unsigned _from;
+    unsigned _to;
+  };
+
+  // A named value describing a benchmark: either a parameter -- e.g. the size
+  // of the data set -- or a metric derived from measures -- e.g. bandwidth.
+  // Values are kept as text, remembering whether they are numbers, so result
+  // sinks can print them without loosing precision.
+  class Property {
+  public:
+    Property(const std::string &nm, const std::string &value, bool numeric)
+      : _name(nm),
+        _value(value),
+        _numeric(numeric) { }
+
+  public:
+    const std::string &name() const { return _name; }
+    const std::string &value() const { return _value; }
+
+    bool numeric() const { return _numeric; }
+
+  private:
+    std::string _name;
+    std::string _value;
+    bool _numeric;
+  };
+
   typedef Clocks::iterator iterator;
+  typedef std::vector<Interval>::const_iterator interval_iterator;
+  typedef std::vector<Property>::const_iterator property_iterator;
 
 public:
   iterator begin() const { return _clocks.begin(); }
   iterator end() const { return _clocks.end(); }
 
+  interval_iterator intervals_begin() const { return _intervals.begin(); }
+  interval_iterator intervals_end() const { return _intervals.end(); }
+
+  property_iterator parameters_begin() const { return _parameters.begin(); }
+  property_iterator parameters_end() const { return _parameters.end(); }
+
+  property_iterator metrics_begin() const { return _metrics.begin(); }
+  property_iterator metrics_end() const { return _metrics.end(); }
+
 protected:
   Benchmark() : _name("UNKNOWN"),
-                _runner(0) { }
+                _baseName(_name),
+                _runner(0),
+                _warmup(0) { }
 
   Benchmark(const std::string &nm, BenchmarkRunner &runner)
     : _name(nm),
-      _runner(&runner) {
+      _baseName(nm),
+      _runner(&runner),
+      _warmup(0) {
     _clocks.reserve(ClkStart, "start");
     _clocks.reserve(ClkEnd, "end");
+
+    interval("total", ClkStart, ClkEnd);
   }
 
 private:
@@ -57,7 +126,32 @@ public:
   virtual void teardown();
   virtual void report();
 
+  // Called once the benchmark has been run at all the points of a sweep, to
+  // release resources kept across them.
+  virtual void release();
+
+public:
+  // Count hardware events during runs -- see PerfCounters. Counters must be
+  // attached after setup, so all the threads used by the benchmark are counted,
+  // and detached before teardown. Detaching records the median value of each
+  // counter, and of metrics derived from them, as benchmark metrics.
+  void attachCounters();
+  void detachCounters();
+
+  const PerfCounters &counters() const { return _counters; }
+
+public:
+  // Prepare the benchmark to be run at another point of a sweep: recorded times
+  // are dropped, and the name is tagged with the label of the point.
+  void point(const std::string &label);
+
 public:
+  // Disabled benchmarks are skipped by the runner. Useful for benchmarks that
+  // must be explicitly requested on the command line.
+  virtual bool enabled() const {
+    return true;
+  }
+
   const std::string &name() const {
     return _name;
   }
@@ -66,6 +160,32 @@ public:
     return std::min(_clocks[ClkStart].size(), _clocks[ClkEnd].size());
   }
 
+  // The first runs can be marked as warm-up: they are excluded from stats.
+  size_t warmup() const {
+    return _warmup;
+  }
+
+  void warmup(size_t runs) {
+    _warmup = runs;
+  }
+
+  // The time spent in the given interval, for each run.
+  TimeStat duration(const Interval &intv) const {
+    return _clocks[intv.to()] - _clocks[intv.from()];
+  }
+
+  // Statistics about the time spent in the given interval, warm-up runs
+  // excluded.
+  Statistics statistics(const Interval &intv) const {
+    return Statistics(_clocks[intv.to()], _clocks[intv.from()], _warmup);
+  }
+
+  // Make room for the times of the given number of runs, so timing does not
+  // allocate memory. Runners call it before repeating the benchmark.
+  void preallocate(size_t runs) {
+    _clocks.preallocate(runs);
+  }
+
 protected:
   virtual void run() = 0;
 
@@ -80,40 +200,132 @@ protected:
     return *reinterpret_cast<Ty *>(_runner);
   }
 
+  // Subclasses recording more clocks can define intervals between them.
+  void interval(const std::string &nm, unsigned from, unsigned to) {
+    _intervals.push_back(Interval(nm, from, to));
+  }
+
+  // Describe the benchmark for result sinks. Setting a property twice
+  // overwrites its value.
+  void parameter(const std::string &nm, const std::string &value);
+  void parameter(const std::string &nm, double value);
+  void metric(const std::string &nm, double value);
+
+private:
+  // Values, for each run, of counters and of metrics derived from them.
+  typedef std::vector<std::pair<std::string, std::vector<double> > >
+          CounterSeries;
+
+  CounterSeries counterSeries() const;
+
 protected:
   Clocks _clocks;
 
 private:
   std::string _name;
+  std::string _baseName;
   BenchmarkRunner *_runner;
+
+  std::vector<Interval> _intervals;
+  size_t _warmup;
+
+  std::vector<Property> _parameters;
+  std::vector<Property> _metrics;
+
+  PerfCounters _counters;
 };
 
 #ifdef HAVE_OPENCL
 
 // Defines some utility methods to ease the process of searching OpenCL devices
-// and setup corresponding contexts.
+// and setup corresponding contexts. Devices may belong to different platforms:
+// each platform has its own context, and its own build of programs.
 class OpenCLAdapter {
+public:
+  // How the last program has been built: caching disabled, loaded from cached
+  // binaries on all platforms, or built from source and then cached.
+  enum ProgramCache {
+    CacheDisabled,
+    CacheHit,
+    CacheMiss
+  };
+
+protected:
+  OpenCLAdapter() : _programCache(CacheDisabled),
+                    _compileTime(0.0) { }
+
 protected:
+  // Find devices of the given type. All of them are taken from the same
+  // platform when possible, otherwise from as many platforms as needed.
   void allocDevices(cl_device_type devType, unsigned devsCount);
   void clearDevices();
 
-  cl::Buffer allocBuffer(size_t size);
+  // Buffers are usable only by devices sharing the context of the given one.
+  cl::Buffer allocBuffer(size_t size, unsigned dev);
+  // Queues are created with profiling enabled.
   cl::CommandQueue allocQueue(unsigned dev);
 
-  void compile(const std::string &dataDir, const std::string &file);
-  cl::Kernel load(const std::string &name);
+  // Build a program from source, passing the given options to the compiler.
+  // If a cache directory is given, binaries are looked up there first, and
+  // stored there after building from source. They are keyed by a hash of the
+  // source, the options, and the name and driver version of each device.
+  void compile(const std::string &dataDir,
+               const std::string &file,
+               const std::string &options = "",
+               const std::string &cacheDir = "");
+  cl::Kernel load(const std::string &name, unsigned dev);
 
   size_t preferredWGSizeMultiple(cl::Kernel &kernel, unsigned dev);
+  size_t maxWGSize(cl::Kernel &kernel, unsigned dev);
+  unsigned computeUnits(unsigned dev);
+  std::string deviceName(unsigned dev);
+
+  // Path of a file caching data about the given key on the given device, e.g.
+  // a compiled program. The name of the file is a hash of the key, of the name
+  // and driver version of the device, and of the version of its platform.
+  std::string cachePath(const std::string &cacheDir,
+                        const std::string &key,
+                        unsigned dev,
+                        const std::string &suffix);
+
+  // Write a file of the given cache directory, creating the directory if
+  // needed. Caching is best effort: errors are ignored.
+  static void storeCacheFile(const std::string &cacheDir,
+                             const std::string &path,
+                             const char *data,
+                             size_t size);
+
+  ProgramCache programCache() const { return _programCache; }
+
+  // Seconds taken by the last compile, whether from source or from binaries,
+  // on all platforms.
+  double compileTime() const { return _compileTime; }
 
 private:
   std::string devTypeToString(cl_device_type devType);
 
+  std::vector<cl::Device> platformDevices(unsigned plat);
+
+  bool loadBinaries(unsigned plat,
+                    const std::string &cacheDir,
+                    const std::string &src,
+                    const std::string &options);
+  void storeBinaries(unsigned plat,
+                     const std::string &cacheDir,
+                     const std::string &src,
+                     const std::string &options);
+
 private:
-  cl::Platform _plat;
-  cl::Context _ctx;
+  std::vector<cl::Platform> _plats;
+  std::vector<cl::Context> _ctxs;
+  std::vector<cl::Program> _progs;
+
   std::vector<cl::Device> _devs;
+  // Index in _plats of the platform of each device.
+  std::vector<unsigned> _devPlats;
 
-  cl::Program _prog;
+  ProgramCache _programCache;
+  double _compileTime;
 };
 
 #endif // HAVE_OPENCL
@@ -3,25 +3,106 @@
 #ifndef FLORENTINO_CLOCK_H
 #define FLORENTINO_CLOCK_H
 
+#include <algorithm>
 #include <iostream>
 #include <numeric>
 #include <string>
 #include <vector>
 
 #include <cassert>
+#include <ctime>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FLORENTINO_HAVE_TSC
+#include <x86intrin.h>
+#endif // __x86_64__ || __i386__
 
 namespace florentino {
 
+// The source clocks read time from. The source is selected once, at startup,
+// before any time is recorded. Two sources are available:
+//
+// - monotonic: clock_gettime(CLOCK_MONOTONIC), ticking in nanoseconds
+// - tsc: the invariant time stamp counter, read with rdtscp, and calibrated
+//   against the monotonic clock
+//
+// Reading the time stamp counter does not enter the C library nor the kernel
+// VDSO, so it is cheaper and less noisy. Selecting a source also measures its
+// resolution and the cost of reading it, like STREAM checktick() does.
+class ClockSource {
+public:
+  enum Kind {
+    Monotonic,
+    TSC
+  };
+
+public:
+  // Get the source with the given name: 'monotonic', 'tsc', or 'auto' -- tsc
+  // if available, monotonic otherwise. Return false if name is not known.
+  static bool parse(const std::string &name, Kind &kind);
+
+  // Whether the given source can be used on this machine.
+  static bool available(Kind kind);
+
+  // Start reading time from the given source, calibrating it. Throws if the
+  // source is not available.
+  static void select(Kind kind);
+
+public:
+  static Kind kind() { return _kind; }
+
+  static const char *name() { return _kind == TSC ? "tsc" : "monotonic"; }
+
+  // Seconds per tick.
+  static double period() { return _period; }
+
+  // Smallest non-zero difference between two readings, in seconds.
+  static double resolution() { return _resolution; }
+
+  // Time taken by a reading, in seconds.
+  static double overhead() { return _overhead; }
+
+public:
+  // Current time, in ticks.
+  static unsigned long long read() {
+#ifdef FLORENTINO_HAVE_TSC
+    if(_kind == TSC) {
+      unsigned aux;
+
+      // Instructions before rdtscp have completed when it reads the counter,
+      // while the fence keeps instructions after it from starting early.
+      unsigned long long ticks = __rdtscp(&aux);
+      _mm_lfence();
+
+      return ticks;
+    }
+#endif // FLORENTINO_HAVE_TSC
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * static_cast<unsigned long long>(1e9) + ts.tv_nsec;
+  }
+
+private:
+  static Kind _kind;
+
+  static double _period;
+  static double _resolution;
+  static double _overhead;
+};
+
 // A statistic about time.
 class TimeStat {
 public:
-  // Record the time an event occurs, in nanoseconds.
+  // Record the time an event occurs, in ticks of the clock source.
   class Tick {
   public:
     Tick(unsigned long long val = 0) : _val(val) { }
 
   public:
-    operator double() const { return _val * 1e-9; }
+    operator double() const { return _val * ClockSource::period(); }
 
   private:
     unsigned long long _val;
@@ -31,7 +112,7 @@ public:
     }
 
     friend std::ostream &operator<<(std::ostream &os, const Tick &tick) {
-      return os << (tick._val * 1e-9);
+      return os << static_cast<double>(tick);
     }
   };
 
@@ -61,6 +142,12 @@ public:
     return _desc;
   }
 
+  // Make room for the given number of values, so recording them never
+  // allocates memory.
+  void preallocate(size_t n) {
+    _values.reserve(n);
+  }
+
   size_t size() const {
     return _values.size();
   }
@@ -70,6 +157,14 @@ public:
            _values.size();
   }
 
+  double min() const {
+    return *std::min_element(_values.begin(), _values.end());
+  }
+
+  double max() const {
+    return *std::max_element(_values.begin(), _values.end());
+  }
+
 protected:
   bool _valid;
 
@@ -79,7 +174,7 @@ protected:
   friend TimeStat operator-(const TimeStat &a, const TimeStat &b) {
     assert(a.valid() && b.valid() && "invalid stats");
 
-    TimeStat c("CIAO");
+    TimeStat c(a.description() + " - " + b.description());
     std::vector<Tick> &values = c._values;
 
     for(iterator i = a.begin(), e = a.end(), j = b.begin(), f = b.end();
@@ -100,13 +195,15 @@ public:
   Clock(const std::string &desc) : TimeStat(desc) { }
 
 public:
+  // Recording is a single store, if enough space has been preallocated.
   void record() {
-    struct timespec ts;
-
-    clock_gettime(CLOCK_MONOTONIC, &ts);
+    _values.push_back(ClockSource::read());
+  }
 
-    _values.push_back(ts.tv_sec * static_cast<unsigned long long>(1e9) +
-                      ts.tv_nsec);
+  // Record a time measured elsewhere -- e.g. by a device -- in ticks of the
+  // clock source.
+  void record(unsigned long long ticks) {
+    _values.push_back(ticks);
   }
 };
 
@@ -135,6 +232,29 @@ public:
     _clocks[id].record();
   }
 
+  void record(unsigned id, unsigned long long ticks) {
+    assert(_clocks.size() > id && "invalid clock id");
+    _clocks[id].record(ticks);
+  }
+
+  // Make room for the times of the given number of runs on every clock. It
+  // must be called before timing, so recording never allocates memory.
+  void preallocate(size_t runs) {
+    for(std::vector<Clock>::iterator i = _clocks.begin(), e = _clocks.end();
+                                     i != e;
+                                     ++i)
+      i->preallocate(runs);
+  }
+
+  // Drop all recorded times, keeping reserved clocks.
+  void clear() {
+    for(std::vector<Clock>::iterator i = _clocks.begin(), e = _clocks.end();
+                                     i != e;
+                                     ++i)
+      if(i->valid())
+        *i = Clock(i->description());
+  }
+
 public:
   Clock &operator[](int id) {
     assert(_clocks.size() > id && "invalid clock id");
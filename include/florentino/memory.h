@@ -2,7 +2,11 @@
 #ifndef FLORENTINO_MEMORY_H
 #define FLORENTINO_MEMORY_H
 
+#include <string>
+
+#include <cassert>
 #include <cstdlib>
+#include <cstring>
 
 // Memory related routines. Notably, guarded memory allocation, aligned memory
 // allocation, and template version to automatically cast to the right type.
@@ -24,6 +28,18 @@ inline void *xcalloc(size_t n, size_t size) {
   return addr;
 }
 
+// Pages backing the returned memory are not touched: they will be mapped on the
+// NUMA node of the thread that first writes them.
+inline void *xaalloc(size_t n, size_t size, size_t align) {
+  void *addr = 0;
+
+  posix_memalign(&addr, align, n * size);
+
+  assert(addr && "memory allocation failed");
+
+  return addr;
+}
+
 inline void *xacalloc(size_t n, size_t size, size_t align) {
   void *addr;
 
@@ -40,6 +56,38 @@ inline void xfree(void *addr) {
   free(addr);
 }
 
+// Kind of pages backing memory allocated by xpalloc:
+//
+// - SmallPages: base pages, usually 4K, never promoted to huge pages
+// - TransparentHugePages: 2M pages, if the kernel can find them, else 4K ones
+// - HugePages2M, HugePages1G: pages reserved by the administrator through
+//                             hugetlbfs; allocation fails if there are not
+//                             enough free pages
+enum PagePolicy {
+  SmallPages,
+  TransparentHugePages,
+  HugePages2M,
+  HugePages1G
+};
+
+// Parse a page policy name -- 4k, thp, 2m, 1g -- returning false on unknown
+// names, and get back its name.
+bool parsePagePolicy(const std::string &name, PagePolicy &policy);
+const char *pagePolicyName(PagePolicy policy);
+
+// Allocate memory backed by pages of the given kind. If node is not negative,
+// memory is bound to that NUMA node, otherwise pages are mapped on the node of
+// the thread that first writes them. Memory is aligned to the page size, and it
+// must be released with xpfree, passing the same size and policy. Allocation
+// errors are reported by throwing an exception, since they are usually caused
+// by the system configuration.
+void *xpalloc(size_t n, size_t size, PagePolicy policy, int node = -1);
+void xpfree(void *addr, size_t n, size_t size, PagePolicy policy);
+
+// Describe the pages actually backing the memory at addr, according to the
+// kernel -- e.g. "4K", "2M", or "2M THP (93%)". Memory must have been touched.
+std::string describePages(const void *addr);
+
 template <typename Ty>
 inline Ty *xalloc() {
   return reinterpret_cast<Ty *>(xalloc(sizeof(Ty)));
@@ -50,11 +98,26 @@ inline Ty *xcalloc(size_t n) {
   return reinterpret_cast<Ty *>(xcalloc(n, sizeof(Ty)));
 }
 
+template <typename Ty>
+inline Ty *xaalloc(size_t n, size_t align) {
+  return reinterpret_cast<Ty *>(xaalloc(n, sizeof(Ty), align));
+}
+
 template <typename Ty>
 inline Ty *xacalloc(size_t n, size_t align) {
   return reinterpret_cast<Ty *>(xacalloc(n, sizeof(Ty), align));
 }
 
+template <typename Ty>
+inline Ty *xpalloc(size_t n, PagePolicy policy, int node = -1) {
+  return reinterpret_cast<Ty *>(xpalloc(n, sizeof(Ty), policy, node));
+}
+
+template <typename Ty>
+inline void xpfree(Ty *addr, size_t n, PagePolicy policy) {
+  xpfree(addr, n, sizeof(Ty), policy);
+}
+
 } // End namespace florentino.
 
 #endif // FLORENTINO_MEMORY_H
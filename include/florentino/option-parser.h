@@ -4,6 +4,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include <cassert>
 #include <cstddef>
@@ -161,6 +162,16 @@ private:
   std::map<char, Option> _options;
 };
 
+// Utilities for option handlers. Sizes are positive numbers, optionally
+// followed by a K, M, or G binary suffix. Sweeps are either FROM:TO:xF, sizes
+// growing geometrically by a factor F, or FROM:TO:+S, sizes growing linearly by
+// a step S. Both return false on malformed input.
+bool parseSize(const std::string &str, size_t &size);
+bool parseSweep(const std::string &str, std::vector<size_t> &sizes);
+
+// The inverse of parseSize: the largest exact binary suffix is used.
+std::string formatSize(size_t size);
+
 } // End namespace florentino.
 
 #endif // FLORENTINO_OPTION_PARSER_H
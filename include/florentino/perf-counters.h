@@ -0,0 +1,93 @@
+
+#ifndef FLORENTINO_PERF_COUNTERS_H
+#define FLORENTINO_PERF_COUNTERS_H
+
+#include <string>
+#include <vector>
+
+namespace florentino {
+
+// Performance counters, read through the Linux perf_event interface. The
+// following counters are opened, if available:
+//
+// - task-clock: time spent running by the counted threads, in nanoseconds
+// - cycles, instructions: core cycles and retired instructions
+// - llc-misses, dtlb-misses: last level cache and data TLB load misses
+// - imc-bytes-read, imc-bytes-written: memory controllers traffic
+//
+// Core counters count all the threads of the process existing when counters are
+// opened. Memory controllers counters are uncore, so they count the whole
+// system, and usually require privileges. Counters that cannot be opened are
+// silently skipped. Counters are read around each run, and the value of each
+// run is kept.
+class PerfCounters {
+public:
+  class Counter {
+  public:
+    Counter(const std::string &nm, double scale) : _name(nm),
+                                                   _scale(scale),
+                                                   _start(0.0) { }
+
+  public:
+    const std::string &name() const { return _name; }
+
+    // Value of the counter for each run.
+    const std::vector<double> &samples() const { return _samples; }
+
+  private:
+    std::string _name;
+    double _scale;
+
+    std::vector<int> _fds;
+    double _start;
+    std::vector<double> _samples;
+
+    friend class PerfCounters;
+  };
+
+  typedef std::vector<Counter>::const_iterator iterator;
+
+public:
+  PerfCounters() : _open(false) { }
+
+  ~PerfCounters() { close(); }
+
+private:
+  // Do not implement.
+  PerfCounters(const PerfCounters &that);
+
+  // Do not implement.
+  const PerfCounters &operator=(const PerfCounters &that);
+
+public:
+  iterator begin() const { return _counters.begin(); }
+  iterator end() const { return _counters.end(); }
+
+  bool empty() const { return _counters.empty(); }
+
+  // Get the given counter, or 0 if it is not available.
+  const Counter *find(const std::string &nm) const;
+
+public:
+  // Open all available counters, dropping previously recorded values.
+  void open();
+
+  // Stop counting, keeping recorded values.
+  void close();
+
+  bool isOpen() const { return _open; }
+
+  // Read counters before and after a run. The difference is the value of the
+  // run.
+  void start();
+  void stop();
+
+private:
+  bool _open;
+
+  std::vector<Counter> _counters;
+};
+
+} // End namespace florentino.
+
+#endif // FLORENTINO_PERF_COUNTERS_H
@@ -0,0 +1,32 @@
+
+#ifndef FLORENTINO_RANDOM_H
+#define FLORENTINO_RANDOM_H
+
+#include <cstddef>
+
+namespace florentino {
+
+// A xorshift64* generator: cheap, but not of high quality. It is meant for
+// resampling and shuffling, not for anything needing good randomness. The
+// seed is fixed by default, so results are reproducible.
+class Random {
+public:
+  Random(unsigned long long seed = 0x9e3779b97f4a7c15ULL) : _state(seed) { }
+
+public:
+  // A random number in [0, n). It can be used with std::random_shuffle.
+  size_t operator()(size_t n) {
+    _state ^= _state >> 12;
+    _state ^= _state << 25;
+    _state ^= _state >> 27;
+
+    return (_state * 0x2545f4914f6cdd1dULL) % n;
+  }
+
+private:
+  unsigned long long _state;
+};
+
+} // End namespace florentino.
+
+#endif // FLORENTINO_RANDOM_H
@@ -0,0 +1,88 @@
+
+#ifndef FLORENTINO_RESULT_SINK_H
+#define FLORENTINO_RESULT_SINK_H
+
+#include <florentino/benchmark.h>
+
+#include <iostream>
+#include <string>
+
+namespace florentino {
+
+// Writes benchmark results in a machine-readable format. Human-readable reports
+// go to the log, while sinks emit, for each benchmark, its metadata, its
+// parameters, every recorded sample, and derived metrics. Sinks are used as
+// follows:
+//
+// sink->begin(command);
+// sink->write(bench); // For each benchmark.
+// sink->end();
+class ResultSink {
+public:
+  // Build the sink for the given format, writing to os. Returns 0 if the
+  // format is unknown.
+  static ResultSink *create(const std::string &format, std::ostream &os);
+
+protected:
+  ResultSink(std::ostream &os) : _os(os) { }
+
+private:
+  // Do not implement.
+  ResultSink(const ResultSink &that);
+
+  // Do not implement.
+  const ResultSink &operator=(const ResultSink &that);
+
+public:
+  virtual ~ResultSink() { }
+
+public:
+  // Start writing results of a process run with the given command line.
+  virtual void begin(const std::string &command) = 0;
+
+  // Write all the results of a benchmark run.
+  virtual void write(const Benchmark &bench) = 0;
+
+  // Complete the output, leaving the sink in a consistent state.
+  virtual void end() = 0;
+
+protected:
+  std::ostream &_os;
+};
+
+// Results are written as a single JSON document, holding an object for each
+// benchmark.
+class JSONResultSink : public ResultSink {
+public:
+  JSONResultSink(std::ostream &os) : ResultSink(os),
+                                     _benchmarks(0) { }
+
+public:
+  virtual void begin(const std::string &command);
+  virtual void write(const Benchmark &bench);
+  virtual void end();
+
+private:
+  unsigned _benchmarks;
+};
+
+// Results are written in long format: each row holds a single value, so all
+// benchmarks share the same columns:
+//
+// benchmark,record,name,run,value
+//
+// The record is one of metadata, parameter, metric, and sample. Only samples
+// have a run, the index of the repetition that recorded them.
+class CSVResultSink : public ResultSink {
+public:
+  CSVResultSink(std::ostream &os) : ResultSink(os) { }
+
+public:
+  virtual void begin(const std::string &command);
+  virtual void write(const Benchmark &bench);
+  virtual void end();
+};
+
+} // End namespace florentino.
+
+#endif // FLORENTINO_RESULT_SINK_H
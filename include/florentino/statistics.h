@@ -0,0 +1,92 @@
+
+#ifndef FLORENTINO_STATISTICS_H
+#define FLORENTINO_STATISTICS_H
+
+#include <florentino/clock.h>
+
+#include <vector>
+
+namespace florentino {
+
+// Descriptive statistics about a TimeStat. Everything is computed once, at
+// construction time: samples are sorted only once, so the cost is dominated by
+// a O(n log n) sort, and querying statistics is cheap. The confidence interval
+// of the mean is computed by bootstrapping when there are few samples; with
+// many samples the normal approximation is used instead, since it is accurate
+// enough and resampling millions of values would be too slow.
+class Statistics {
+public:
+  static const double CONFIDENCE;
+  static const unsigned BOOTSTRAP_RESAMPLES;
+  static const size_t BOOTSTRAP_MAX_SAMPLES;
+
+public:
+  // Compute statistics about stat samples, ignoring the first skip ones.
+  Statistics(const TimeStat &stat, size_t skip = 0);
+
+  // The same, but for the time elapsed from each sample of from to the
+  // corresponding sample of to. No intermediate TimeStat is built.
+  Statistics(const TimeStat &to, const TimeStat &from, size_t skip = 0);
+
+  // The same, but for samples, in seconds, not coming from a clock -- e.g.
+  // loaded from a file.
+  Statistics(const std::vector<double> &samples, size_t skip = 0);
+
+public:
+  // Detect how many samples at the beginning of stat belong to a warm-up phase
+  // -- e.g. frequency ramp-up, page faults -- and should be dropped. It uses
+  // the Marginal Standard Error Rule (MSER): the truncation point minimizes the
+  // standard error of the mean of the remaining samples. At most half of the
+  // samples are considered warm-up.
+  static size_t warmup(const TimeStat &stat);
+
+  // One-sided Mann-Whitney U test: the p-value of the null hypothesis that
+  // samples of b are not stochastically greater than samples of a. It makes no
+  // assumptions about distributions, so it is robust to the skewed, outlier
+  // rich, distributions of timings. The normal approximation, corrected for
+  // ties, is used.
+  static double mannWhitney(const Statistics &a, const Statistics &b);
+
+public:
+  size_t size() const { return _sorted.size(); }
+  bool empty() const { return _sorted.empty(); }
+
+  double min() const { return _sorted.front(); }
+  double max() const { return _sorted.back(); }
+
+  double mean() const { return _mean; }
+  double median() const { return percentile(50.0); }
+
+  // The p-th percentile, with p in [0, 100]. Linear interpolation is used
+  // between the closest ranks.
+  double percentile(double p) const;
+
+  double stddev() const { return _stddev; }
+
+  // Coefficient of variation: standard deviation relative to the mean.
+  double cv() const { return _mean ? _stddev / _mean : 0.0; }
+
+  // Bounds of the confidence interval of the mean.
+  double ciLow() const { return _ciLow; }
+  double ciHigh() const { return _ciHigh; }
+
+  // Width of the confidence interval, relative to the mean.
+  double ciWidth() const { return _mean ? (_ciHigh - _ciLow) / _mean : 0.0; }
+
+private:
+  void compute();
+  void bootstrap();
+
+private:
+  std::vector<double> _sorted;
+
+  double _mean;
+  double _stddev;
+
+  double _ciLow;
+  double _ciHigh;
+};
+
+} // End namespace florentino.
+
+#endif // FLORENTINO_STATISTICS_H
@@ -0,0 +1,100 @@
+
+#ifndef FLORENTINO_THREAD_H
+#define FLORENTINO_THREAD_H
+
+#include <vector>
+
+#include <cassert>
+
+#include <pthread.h>
+
+namespace florentino {
+
+// A team of threads, each one pinned to a CPU. The thread building the team is
+// its first member: it is pinned to the first CPU and it executes its share of
+// work inside ThreadTeam::run. The other members are created once and wait on a
+// barrier between runs, so dispatching work does not spawn any thread.
+class ThreadTeam {
+public:
+  // Routine executed by all team members: arg is an user argument, id is the
+  // index of the member executing the routine, and count is the team size.
+  typedef void (*Routine)(void *arg, unsigned id, unsigned count);
+
+public:
+  // Build a team with a member for each entry of cpus. The same CPU can be
+  // listed multiple times.
+  ThreadTeam(const std::vector<unsigned> &cpus);
+  ~ThreadTeam();
+
+private:
+  ThreadTeam(const ThreadTeam &that); // Do not implement.
+  const ThreadTeam &operator=(const ThreadTeam &that); // Do not implement.
+
+public:
+  // Execute routine on all members, and return when all of them are done.
+  void run(Routine routine, void *arg);
+
+public:
+  unsigned size() const { return _cpus.size(); }
+
+  unsigned cpu(unsigned id) const {
+    assert(id < _cpus.size() && "invalid member id");
+    return _cpus[id];
+  }
+
+public:
+  // The CPUs the calling thread is allowed to run on.
+  static std::vector<unsigned> availableCPUs();
+
+  // Take count CPUs from cpus, going round-robin if there are not enough CPUs.
+  static std::vector<unsigned> spread(const std::vector<unsigned> &cpus,
+                                      unsigned count);
+
+private:
+  static void *member(void *arg);
+
+  // Tell started members whether the team has been fully built, and wait for
+  // them to exit if not.
+  void startup(bool started);
+
+private:
+  // Members wait the whole team to be built before entering the barriers: if
+  // building fails, they exit without ever waiting on them.
+  enum Startup {
+    Starting,
+    Started,
+    Aborted
+  };
+
+private:
+  class Member {
+  public:
+    Member(ThreadTeam *team = 0, unsigned id = 0) : _team(team),
+                                                    _id(id) { }
+
+  public:
+    ThreadTeam *_team;
+    unsigned _id;
+    pthread_t _thread;
+  };
+
+private:
+  std::vector<unsigned> _cpus;
+  std::vector<Member> _members;
+
+  cpu_set_t _masterMask;
+
+  pthread_mutex_t _startupLock;
+  pthread_cond_t _startupCond;
+  Startup _startup;
+
+  pthread_barrier_t _start;
+  pthread_barrier_t _done;
+
+  Routine _routine;
+  void *_arg;
+};
+
+} // End namespace florentino.
+
+#endif // FLORENTINO_THREAD_H
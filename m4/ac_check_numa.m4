@@ -0,0 +1,14 @@
+dnl: ac_check_numa.m4: check for NUMA policy library.
+
+AC_DEFUN([AC_CHECK_NUMA],
+[
+
+AC_CHECK_HEADERS([numa.h], [ac_check_have_numa_h=yes])
+AC_CHECK_LIB([numa], [numa_available], [ac_check_have_libnuma=yes])
+
+AS_IF([test "x$ac_check_have_numa_h" = "xyes" -a \
+            "x$ac_check_have_libnuma" = "xyes"],
+      [AC_DEFINE([HAVE_NUMA], [1])
+       LIBS="-lnuma $LIBS"])
+
+])
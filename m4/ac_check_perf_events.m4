@@ -0,0 +1,14 @@
+dnl: ac_check_perf_events.m4: check for Linux performance counters.
+
+AC_DEFUN([AC_CHECK_PERF_EVENTS],
+[
+
+AC_CHECK_HEADERS([linux/perf_event.h], [ac_check_have_perf_event_h=yes])
+AC_CHECK_DECL([SYS_perf_event_open], [ac_check_have_perf_event_open=yes], [],
+              [#include <sys/syscall.h>])
+
+AS_IF([test "x$ac_check_have_perf_event_h" = "xyes" -a \
+            "x$ac_check_have_perf_event_open" = "xyes"],
+      [AC_DEFINE([HAVE_PERF_EVENTS], [1])])
+
+])
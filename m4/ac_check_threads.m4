@@ -0,0 +1,11 @@
+dnl: ac_check_threads.m4: check for POSIX threads.
+
+AC_DEFUN([AC_CHECK_THREADS],
+[
+
+AC_CHECK_HEADERS([pthread.h], [],
+                 [AC_MSG_ERROR([POSIX threads headers not found])])
+AC_CHECK_LIB([pthread], [pthread_create], [],
+             [AC_MSG_ERROR([POSIX threads library not found])])
+
+])
@@ -0,0 +1,350 @@
+
+#include "florentino/baseline.h"
+
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace florentino;
+
+namespace {
+
+// A JSON value. Just what is needed to read back result files, so numbers are
+// always doubles, and objects are kept as lists of members.
+class JSONValue {
+public:
+  enum Kind {
+    Null,
+    Boolean,
+    Number,
+    String,
+    Array,
+    Object
+  };
+
+  typedef std::vector<JSONValue> Elements;
+  typedef std::vector<std::pair<std::string, JSONValue> > Members;
+
+public:
+  JSONValue(Kind kind = Null) : _kind(kind),
+                                _number(0.0) { }
+
+public:
+  // Get the given member of an object, or 0 if the value is not an object or
+  // it does not have such member.
+  const JSONValue *member(const std::string &nm) const {
+    for(Members::const_iterator i = _members.begin(),
+                                e = _members.end();
+                                i != e;
+                                ++i)
+      if(i->first == nm)
+        return &i->second;
+
+    return 0;
+  }
+
+public:
+  Kind _kind;
+
+  double _number;
+  std::string _string;
+  Elements _elements;
+  Members _members;
+};
+
+// A recursive descent parser. Errors are reported by throwing an exception,
+// telling the offset where parsing failed.
+class JSONParser {
+public:
+  JSONParser(const std::string &text) : _text(text),
+                                        _cur(0) { }
+
+public:
+  JSONValue parse() {
+    JSONValue value = parseValue();
+
+    skipSpaces();
+    if(_cur != _text.size())
+      error("trailing characters");
+
+    return value;
+  }
+
+private:
+  JSONValue parseValue() {
+    skipSpaces();
+
+    if(_cur == _text.size())
+      error("unexpected end of input");
+
+    switch(_text[_cur]) {
+    case '{':
+      return parseObject();
+
+    case '[':
+      return parseArray();
+
+    case '"': {
+      JSONValue value(JSONValue::String);
+      value._string = parseString();
+
+      return value;
+    }
+
+    case 't':
+      expect("true");
+      return boolean(true);
+
+    case 'f':
+      expect("false");
+      return boolean(false);
+
+    case 'n':
+      expect("null");
+      return JSONValue();
+    }
+
+    return parseNumber();
+  }
+
+  JSONValue parseObject() {
+    JSONValue value(JSONValue::Object);
+
+    expect("{");
+    if(skipSpaces() == '}') {
+      ++_cur;
+      return value;
+    }
+
+    do {
+      skipSpaces();
+      std::string nm = parseString();
+
+      skipSpaces();
+      expect(":");
+
+      value._members.push_back(std::make_pair(nm, parseValue()));
+    } while(next(',', '}'));
+
+    return value;
+  }
+
+  JSONValue parseArray() {
+    JSONValue value(JSONValue::Array);
+
+    expect("[");
+    if(skipSpaces() == ']') {
+      ++_cur;
+      return value;
+    }
+
+    do {
+      value._elements.push_back(parseValue());
+    } while(next(',', ']'));
+
+    return value;
+  }
+
+  std::string parseString() {
+    std::string str;
+
+    expect("\"");
+
+    while(_cur != _text.size() && _text[_cur] != '"') {
+      char c = _text[_cur++];
+
+      if(c != '\\') {
+        str += c;
+        continue;
+      }
+
+      if(_cur == _text.size())
+        break;
+
+      switch(c = _text[_cur++]) {
+      case 'b': str += '\b'; break;
+      case 'f': str += '\f'; break;
+      case 'n': str += '\n'; break;
+      case 'r': str += '\r'; break;
+      case 't': str += '\t'; break;
+
+      // Only ASCII escapes are written by result sinks.
+      case 'u':
+        if(_cur + 4 > _text.size())
+          error("invalid escape sequence");
+
+        str += static_cast<char>(std::strtol(_text.substr(_cur, 4).c_str(),
+                                             0,
+                                             16));
+        _cur += 4;
+        break;
+
+      default:
+        str += c;
+      }
+    }
+
+    expect("\"");
+
+    return str;
+  }
+
+  JSONValue parseNumber() {
+    const char *begin = _text.c_str() + _cur;
+    char *end;
+
+    JSONValue value(JSONValue::Number);
+    value._number = std::strtod(begin, &end);
+
+    if(end == begin)
+      error("unexpected character");
+
+    _cur += end - begin;
+
+    return value;
+  }
+
+private:
+  JSONValue boolean(bool val) {
+    JSONValue value(JSONValue::Boolean);
+    value._number = val;
+
+    return value;
+  }
+
+  // Skip white spaces, and return the next character, or 0 at the end.
+  char skipSpaces() {
+    while(_cur != _text.size() && std::strchr(" \t\r\n", _text[_cur]))
+      ++_cur;
+
+    return _cur != _text.size() ? _text[_cur] : 0;
+  }
+
+  void expect(const char *token) {
+    size_t len = std::strlen(token);
+
+    if(_text.compare(_cur, len, token)) {
+      std::ostringstream os;
+      os << "expected '" << token << "'";
+
+      error(os.str());
+    }
+
+    _cur += len;
+  }
+
+  // Consume either the separator -- returning true -- or the terminator.
+  bool next(char separator, char terminator) {
+    char c = skipSpaces();
+
+    if(c != separator && c != terminator) {
+      std::ostringstream os;
+      os << "expected '" << separator << "' or '" << terminator << "'";
+
+      error(os.str());
+    }
+
+    ++_cur;
+
+    return c == separator;
+  }
+
+  void error(const std::string &msg) {
+    std::ostringstream os;
+    os << msg << " at offset " << _cur;
+
+    throw std::runtime_error(os.str());
+  }
+
+private:
+  const std::string &_text;
+  size_t _cur;
+};
+
+} // End anonymous namespace.
+
+//
+// Baseline implementation.
+//
+
+Baseline::Baseline(const std::string &path) : _path(path) {
+  std::ifstream is(path.c_str());
+
+  if(!is) {
+    std::ostringstream os;
+    os << "Error: cannot open '" << path << "'";
+
+    throw std::runtime_error(os.str());
+  }
+
+  // Note: the double '(' and ')' are really needed: do not remove!
+  std::string text((std::istreambuf_iterator<char>(is)),
+                   (std::istreambuf_iterator<char>()));
+
+  try {
+    JSONValue root = JSONParser(text).parse();
+    const JSONValue *benchs = root.member("benchmarks");
+
+    if(!benchs || benchs->_kind != JSONValue::Array)
+      throw std::runtime_error("no benchmarks");
+
+    for(JSONValue::Elements::const_iterator i = benchs->_elements.begin(),
+                                             e = benchs->_elements.end();
+                                             i != e;
+                                             ++i) {
+      const JSONValue *nm = i->member("name"),
+                      *warmup = i->member("warmup"),
+                      *intervals = i->member("intervals");
+
+      if(!nm || nm->_kind != JSONValue::String ||
+         !intervals || intervals->_kind != JSONValue::Array)
+        throw std::runtime_error("malformed benchmark");
+
+      size_t skip = warmup && warmup->_kind == JSONValue::Number
+                    ? static_cast<size_t>(warmup->_number)
+                    : 0;
+
+      Intervals &bench = _benchmarks[nm->_string];
+
+      for(JSONValue::Elements::const_iterator j = intervals->_elements.begin(),
+                                              f = intervals->_elements.end();
+                                              j != f;
+                                              ++j) {
+        const JSONValue *intvName = j->member("name"),
+                        *samples = j->member("samples");
+
+        if(!intvName || intvName->_kind != JSONValue::String ||
+           !samples || samples->_kind != JSONValue::Array)
+          throw std::runtime_error("malformed interval");
+
+        std::vector<double> &values = bench[intvName->_string];
+
+        // Warm-up runs are not part of the baseline.
+        for(size_t k = skip, g = samples->_elements.size(); k < g; ++k)
+          values.push_back(samples->_elements[k]._number);
+      }
+    }
+
+  } catch(const std::exception &ex) {
+    std::ostringstream os;
+    os << "Error: malformed baseline '" << path << "': " << ex.what();
+
+    throw std::runtime_error(os.str());
+  }
+}
+
+const std::vector<double> *Baseline::samples(const std::string &bench,
+                                             const std::string &intv) const {
+  std::map<std::string, Intervals>::const_iterator i = _benchmarks.find(bench);
+
+  if(i == _benchmarks.end())
+    return 0;
+
+  Intervals::const_iterator j = i->second.find(intv);
+
+  return j != i->second.end() ? &j->second : 0;
+}
@@ -1,11 +1,15 @@
 
 #include "florentino/benchmark-runner.h"
+#include "florentino/statistics.h"
 
+#include <algorithm>
+#include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
 
 #include <cstdlib>
+#include <ctime>
 
 using namespace florentino;
 
@@ -35,6 +39,172 @@ void timesHandler(void *arg, const char *optArg) {
   *times = value;
 }
 
+void maxTimesHandler(void *arg, const char *optArg) {
+  unsigned int *maxTimes = reinterpret_cast<unsigned int *>(arg);
+
+  // Parse into a signed type to get detected whether the used specified a
+  // negative number.
+  int value;
+
+  std::istringstream is(optArg);
+  is >> value;
+
+  if(is.fail() || !is.eof()) {
+    std::ostringstream os;
+    os << "Error: option '-m' expects a positive number, "
+          "got '" << optArg << "'";
+
+    throw std::runtime_error(os.str());
+  }
+
+  if(value < 1)
+    throw std::runtime_error("Error: option '-m' expects a positive number");
+
+  *maxTimes = value;
+}
+
+void targetWidthHandler(void *arg, const char *optArg) {
+  double *targetWidth = reinterpret_cast<double *>(arg);
+
+  double value;
+
+  std::istringstream is(optArg);
+  is >> value;
+
+  if(is.fail() || !is.eof() || value <= 0.0 || value >= 1.0) {
+    std::ostringstream os;
+    os << "Error: option '-a' expects a number in (0, 1), "
+          "got '" << optArg << "'";
+
+    throw std::runtime_error(os.str());
+  }
+
+  *targetWidth = value;
+}
+
+void timeBudgetHandler(void *arg, const char *optArg) {
+  double *timeBudget = reinterpret_cast<double *>(arg);
+
+  double value;
+
+  std::istringstream is(optArg);
+  is >> value;
+
+  if(is.fail() || !is.eof() || value <= 0.0) {
+    std::ostringstream os;
+    os << "Error: option '-w' expects a positive number, "
+          "got '" << optArg << "'";
+
+    throw std::runtime_error(os.str());
+  }
+
+  *timeBudget = value;
+}
+
+void formatHandler(void *arg, const char *optArg) {
+  std::string *format = reinterpret_cast<std::string *>(arg);
+  std::string value(optArg);
+
+  if(value != "text" && value != "json" && value != "csv") {
+    std::ostringstream os;
+    os << "Error: option '-f' expects one of text, json, csv, "
+          "got '" << optArg << "'";
+
+    throw std::runtime_error(os.str());
+  }
+
+  *format = value;
+}
+
+void outputHandler(void *arg, const char *optArg) {
+  std::string *output = reinterpret_cast<std::string *>(arg);
+
+  // The file is opened only after all options have been parsed.
+  *output = optArg;
+}
+
+void baselineHandler(void *arg, const char *optArg) {
+  std::string *baseline = reinterpret_cast<std::string *>(arg);
+
+  // The file is loaded only after all options have been parsed.
+  *baseline = optArg;
+}
+
+void thresholdHandler(void *arg, const char *optArg) {
+  double *threshold = reinterpret_cast<double *>(arg);
+
+  double value;
+
+  std::istringstream is(optArg);
+  is >> value;
+
+  if(is.fail() || !is.eof() || value < 0.0 || value >= 1.0) {
+    std::ostringstream os;
+    os << "Error: option '-x' expects a number in [0, 1), "
+          "got '" << optArg << "'";
+
+    throw std::runtime_error(os.str());
+  }
+
+  *threshold = value;
+}
+
+void countersHandler(void *arg, const char *optArg) {
+  bool *counters = reinterpret_cast<bool *>(arg);
+
+  *counters = true;
+}
+
+void pagePolicyHandler(void *arg, const char *optArg) {
+  PagePolicy *pagePolicy = reinterpret_cast<PagePolicy *>(arg);
+
+  if(!parsePagePolicy(optArg, *pagePolicy)) {
+    std::ostringstream os;
+    os << "Error: option '-g' expects one of 4k, thp, 2m, 1g, "
+          "got '" << optArg << "'";
+
+    throw std::runtime_error(os.str());
+  }
+}
+
+void clockSourceHandler(void *arg, const char *optArg) {
+  ClockSource::Kind *clockSource = reinterpret_cast<ClockSource::Kind *>(arg);
+
+  if(!ClockSource::parse(optArg, *clockSource)) {
+    std::ostringstream os;
+    os << "Error: option '-k' expects one of monotonic, tsc, auto, "
+          "got '" << optArg << "'";
+
+    throw std::runtime_error(os.str());
+  }
+}
+
+// Seconds spent to record a time on a clock, that is the overhead the timing
+// path adds to each interval. Storage is preallocated, as in benchmarks.
+double timingOverhead() {
+  const unsigned Records = 1000;
+
+  Clocks clocks;
+  clocks.reserve(0, "overhead");
+  clocks.preallocate(Records);
+
+  for(unsigned i = 0; i != Records; ++i)
+    clocks.record(0);
+
+  const Clock &clock = clocks[0];
+
+  return (clock[Records - 1] - clock[0]) / (Records - 1.0);
+}
+
+// Seconds elapsed since an arbitrary point in the past.
+double now() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
 void verboseHandler(void *arg, const char *optArg) {
   bool *verbose = reinterpret_cast<bool *>(arg);
 
@@ -47,15 +217,68 @@ void verboseHandler(void *arg, const char *optArg) {
 // BenchmarkRunner implementation.
 //
 
-BenchmarkRunner::BenchmarkRunner(int argc, char **argv) : _options(argc, argv),
-                                                          _times(DEFAULT_TIMES),
-                                                          _verbose(DEFAULT_VERBOSE) {
+const double BenchmarkRunner::DEFAULT_TARGET_WIDTH = 0.0;
+const double BenchmarkRunner::DEFAULT_TIME_BUDGET = 60.0;
+const std::string BenchmarkRunner::DEFAULT_FORMAT = "text";
+const std::string BenchmarkRunner::DEFAULT_OUTPUT = "";
+const std::string BenchmarkRunner::DEFAULT_BASELINE = "";
+const double BenchmarkRunner::DEFAULT_THRESHOLD = 0.05;
+const std::string BenchmarkRunner::DEFAULT_CLOCK_SOURCE = "auto";
+
+BenchmarkRunner::BenchmarkRunner(int argc, char **argv)
+  : _options(argc, argv),
+    _times(DEFAULT_TIMES),
+    _verbose(DEFAULT_VERBOSE),
+    _targetWidth(DEFAULT_TARGET_WIDTH),
+    _timeBudget(DEFAULT_TIME_BUDGET),
+    _maxTimes(DEFAULT_MAX_TIMES),
+    _format(DEFAULT_FORMAT),
+    _output(DEFAULT_OUTPUT),
+    _baseline(DEFAULT_BASELINE),
+    _threshold(DEFAULT_THRESHOLD),
+    _counters(DEFAULT_COUNTERS),
+    _pagePolicy(DEFAULT_PAGE_POLICY) {
+  ClockSource::parse(DEFAULT_CLOCK_SOURCE, _clockSource);
+
+  for(int i = 0; i < argc; ++i)
+    _command += (i ? " " : "") + std::string(argv[i]);
+
   _options.add(Option('r', Option::REQUIRED_ARGUMENT,
                       timesHandler, &_times,
                       "-r R", "repeat benchmark R times"));
   _options.add(Option('v', Option::NO_ARGUMENT,
                       verboseHandler, &_verbose,
                       "-v", "enable verbose output"));
+  _options.add(Option('a', Option::REQUIRED_ARGUMENT,
+                      targetWidthHandler, &_targetWidth,
+                      "-a E", "repeat benchmark until relative CI width is E"));
+  _options.add(Option('w', Option::REQUIRED_ARGUMENT,
+                      timeBudgetHandler, &_timeBudget,
+                      "-w S", "with -a, repeat benchmark for up to S seconds"));
+  _options.add(Option('m', Option::REQUIRED_ARGUMENT,
+                      maxTimesHandler, &_maxTimes,
+                      "-m M", "with -a, repeat benchmark at most M times"));
+  _options.add(Option('f', Option::REQUIRED_ARGUMENT,
+                      formatHandler, &_format,
+                      "-f F", "also write results in F (json, csv) format"));
+  _options.add(Option('o', Option::REQUIRED_ARGUMENT,
+                      outputHandler, &_output,
+                      "-o O", "with -f, write results to file O"));
+  _options.add(Option('b', Option::REQUIRED_ARGUMENT,
+                      baselineHandler, &_baseline,
+                      "-b B", "compare results against JSON baseline B"));
+  _options.add(Option('x', Option::REQUIRED_ARGUMENT,
+                      thresholdHandler, &_threshold,
+                      "-x X", "with -b, fail on bandwidth drops above X"));
+  _options.add(Option('p', Option::NO_ARGUMENT,
+                      countersHandler, &_counters,
+                      "-p", "read hardware performance counters"));
+  _options.add(Option('g', Option::REQUIRED_ARGUMENT,
+                      pagePolicyHandler, &_pagePolicy,
+                      "-g G", "back data with G (4k, thp, 2m, 1g) pages"));
+  _options.add(Option('k', Option::REQUIRED_ARGUMENT,
+                      clockSourceHandler, &_clockSource,
+                      "-k K", "read time from K (monotonic, tsc, auto) clock"));
 }
 
 BenchmarkRunner::~BenchmarkRunner() {
@@ -68,43 +291,283 @@ BenchmarkRunner::~BenchmarkRunner() {
 int BenchmarkRunner::run() {
   typedef std::vector<Benchmark *>::iterator iterator;
 
+  std::ofstream file;
+  ResultSink *sink = 0;
+  Baseline *baseline = 0;
+
   try {
     _options.parse();
 
+    ClockSource::select(_clockSource);
+
+    if(!_baseline.empty())
+      baseline = new Baseline(_baseline);
+
+    sink = openSink(file);
+
   } catch(const std::exception &ex) {
     std::cerr << ex.what() << std::endl;
+
+    delete baseline;
     return EXIT_FAILURE;
   }
 
   _log.verbose(_verbose);
 
+  std::ostringstream clock;
+  clock << std::fixed << std::setprecision(2) << ClockSource::name();
+
+  if(ClockSource::kind() == ClockSource::TSC)
+    clock << ", " << 1e-9 / ClockSource::period() << " GHz";
+
+  clock << ", resolution = " << ClockSource::resolution() * 1e9 << " ns"
+        << ", overhead = " << ClockSource::overhead() * 1e9 << " ns"
+        << ", timing overhead = " << timingOverhead() * 1e9 << " ns";
+
+  _log << "Clock = " << clock.str() << std::endl;
+
+  if(sink)
+    sink->begin(_command);
+
+  int exitCode = EXIT_SUCCESS;
+  unsigned regressions = 0;
+
   for(iterator i = _benchmarks.begin(), e = _benchmarks.end(); i != e; ++i) {
     Benchmark *bench = *i;
 
+    if(!bench->enabled())
+      continue;
+
     try {
-      _log << "*** Start benchmark " << bench->name() << std::endl;
+      for(unsigned j = 0, f = pointsCount(); j != f; ++j) {
+        bench->point(selectPoint(j));
 
-      bench->setup();
-      for(unsigned j = 0, f = _times; j != f; ++j)
-        bench->execute();
-      bench->teardown();
+        _log << "*** Start benchmark " << bench->name() << std::endl;
 
-      _log.verbose(true);
-      _log << bench->name();
+        bench->setup();
+
+        if(_counters)
+          bench->attachCounters();
+
+        // Recording times must not allocate memory inside timed regions.
+        bench->preallocate(_targetWidth ? _maxTimes : _times);
+
+        if(_targetWidth)
+          repeatAdaptive(*bench);
+        else
+          repeat(*bench);
+
+        if(_counters)
+          bench->detachCounters();
 
-      bench->report();
+        bench->teardown();
 
-      _log << std::endl;
-      _log.verbose(_verbose);
+        _log.verbose(true);
+        _log << bench->name();
 
-      _log << "*** End benchmark " << bench->name() << std::endl;
+        bench->report();
+
+        _log << std::endl;
+        _log.verbose(_verbose);
+
+        if(sink)
+          sink->write(*bench);
+
+        if(baseline) {
+          _log.verbose(true);
+          regressions += compare(*bench, *baseline);
+          _log.verbose(_verbose);
+        }
+
+        _log << "*** End benchmark " << bench->name() << std::endl;
+      }
+
+      bench->release();
 
     } catch(const std::exception &ex) {
+      // Errors must always be visible.
+      _log.verbose(true);
       _log << ex.what() << std::endl
            << "*** End benchmark " << bench->name() << std::endl;
-      return EXIT_FAILURE;
+      exitCode = EXIT_FAILURE;
+      break;
     }
   }
 
-  return EXIT_SUCCESS;
+  if(exitCode == EXIT_SUCCESS) {
+    _log.verbose(true);
+    summarize();
+    _log.verbose(_verbose);
+  }
+
+  // Results of the benchmarks run so far are always kept well-formed.
+  if(sink) {
+    sink->end();
+    delete sink;
+  }
+
+  if(regressions) {
+    _log.verbose(true);
+    _log << "Error: " << regressions << " regression"
+         << (regressions == 1 ? "" : "s") << " against baseline '"
+         << baseline->path() << "'" << std::endl;
+    _log.verbose(_verbose);
+
+    exitCode = EXIT_FAILURE;
+  }
+
+  delete baseline;
+
+  return exitCode;
+}
+
+ResultSink *BenchmarkRunner::openSink(std::ofstream &file) {
+  if(_format == "text") {
+    if(!_output.empty())
+      throw std::runtime_error("Error: option '-o' requires option '-f'");
+
+    return 0;
+  }
+
+  // Human-readable output goes to the standard error, so the standard output
+  // is free for results.
+  if(_output.empty())
+    return ResultSink::create(_format, std::cout);
+
+  file.open(_output.c_str());
+
+  if(!file) {
+    std::ostringstream os;
+    os << "Error: cannot open '" << _output << "'";
+
+    throw std::runtime_error(os.str());
+  }
+
+  return ResultSink::create(_format, file);
+}
+
+void BenchmarkRunner::repeat(Benchmark &bench) {
+  for(unsigned i = 0, e = _times; i != e; ++i)
+    bench.execute();
+}
+
+void BenchmarkRunner::repeatAdaptive(Benchmark &bench) {
+  // Convergence is checked on the first interval, the whole benchmark.
+  const Benchmark::Interval &main = *bench.intervals_begin();
+
+  double start = now(),
+         width = 0.0;
+
+  size_t warmup = 0,
+         nextCheck = MIN_ADAPTIVE_TIMES;
+
+  const char *reason = 0;
+
+  while(!reason) {
+    bench.execute();
+
+    size_t runs = bench.runs();
+
+    if(runs >= _maxTimes)
+      reason = "repetitions budget exhausted";
+    else if(now() - start >= _timeBudget)
+      reason = "time budget exhausted";
+
+    // Checking for convergence means computing statistics. Do that on a
+    // geometric schedule, so checks do not dominate the run time.
+    if(runs < nextCheck && !reason)
+      continue;
+
+    nextCheck = std::max(runs + 1, runs + runs / 10);
+
+    const TimeStat &stat = bench.duration(main);
+
+    warmup = Statistics::warmup(stat);
+
+    Statistics stats(stat, warmup);
+    width = stats.ciWidth();
+
+    if(stats.size() >= MIN_ADAPTIVE_TIMES && width <= _targetWidth)
+      reason = "converged";
+  }
+
+  bench.warmup(warmup);
+
+  _log << "Adaptive repetition: " << reason << " after "
+       << bench.runs() << " runs, "
+       << warmup << " warm-up runs dropped, "
+       << "relative CI width "
+       << std::fixed << std::setprecision(4) << width
+       << std::endl;
+}
+
+unsigned BenchmarkRunner::compare(const Benchmark &bench,
+                                  const Baseline &baseline) {
+  typedef Benchmark::interval_iterator interval_iterator;
+
+  unsigned regressions = 0;
+
+  _log << "Baseline comparison, median times:" << std::endl
+
+       << "  " << std::left << std::setw(10) << "interval" << std::right
+       << std::setw(12) << "baseline"
+       << std::setw(12) << "current"
+       << std::setw(12) << "bandwidth"
+       << std::setw(10) << "p-value"
+       << "  verdict"
+       << std::endl;
+
+  for(interval_iterator i = bench.intervals_begin(),
+                        e = bench.intervals_end();
+                        i != e;
+                        ++i) {
+    const std::vector<double> *samples = baseline.samples(bench.name(),
+                                                          i->name());
+
+    _log << "  " << std::left << std::setw(10) << i->name() << std::right;
+
+    if(!samples || samples->empty()) {
+      _log << "  not in baseline" << std::endl;
+      continue;
+    }
+
+    Statistics before(*samples),
+               after = bench.statistics(*i);
+
+    if(after.empty()) {
+      _log << "  no samples" << std::endl;
+      continue;
+    }
+
+    // Bandwidth is inversely proportional to time. Slower runs are detected
+    // with a test on times, so the whole distributions are compared, not just
+    // medians.
+    double change = before.median() / after.median() - 1.0,
+           slower = Statistics::mannWhitney(before, after),
+           faster = Statistics::mannWhitney(after, before),
+           alpha = 1.0 - Statistics::CONFIDENCE,
+           p = change < 0.0 ? slower : faster;
+
+    const char *verdict = "same";
+
+    if(-change > _threshold && p < alpha) {
+      verdict = "REGRESSION";
+      ++regressions;
+    } else if(change > _threshold && p < alpha) {
+      verdict = "improved";
+    }
+
+    _log << std::scientific << std::setprecision(4)
+         << std::setw(12) << before.median()
+         << std::setw(12) << after.median()
+         << std::fixed << std::setprecision(1)
+         << std::setw(11) << std::showpos << change * 100.0 << std::noshowpos
+         << "%"
+         << std::setprecision(4)
+         << std::setw(10) << p
+         << "  " << verdict
+         << std::endl;
+  }
+
+  return regressions;
 }
@@ -1,46 +1,301 @@
 
 #include "florentino/benchmark-runner.h"
+#include "florentino/statistics.h"
 
+#include <algorithm>
 #include <fstream>
+#include <iomanip>
 #include <iterator>
 #include <sstream>
 #include <stdexcept>
 
+#include <cmath>
+#include <cstdio>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
 using namespace florentino;
 
+namespace {
+
+#ifdef HAVE_OPENCL
+// Programs are cached by source and build options.
+std::string programKey(const std::string &src, const std::string &options) {
+  return src + '\0' + options;
+}
+#endif // HAVE_OPENCL
+
+void setProperty(std::vector<Benchmark::Property> &props,
+                 const Benchmark::Property &prop) {
+  typedef std::vector<Benchmark::Property>::iterator iterator;
+
+  for(iterator i = props.begin(), e = props.end(); i != e; ++i)
+    if(i->name() == prop.name()) {
+      *i = prop;
+      return;
+    }
+
+  props.push_back(prop);
+}
+
+Benchmark::Property numericProperty(const std::string &nm, double value) {
+  std::ostringstream os;
+  os << std::setprecision(10) << value;
+
+  // Infinities and NaNs are not numbers for most data formats.
+  return Benchmark::Property(nm, os.str(), std::isfinite(value));
+}
+
+// Derived series are reported only if they could be computed.
+void addSeries(std::vector<std::pair<std::string,
+                                     std::vector<double> > > &series,
+               const char *nm,
+               const std::vector<double> &values) {
+  if(!values.empty())
+    series.push_back(std::make_pair(std::string(nm), values));
+}
+
+} // End anonymous namespace.
+
 //
 // Benchmark implementation.
 //
 
 void Benchmark::execute() {
+  bool counting = _counters.isOpen();
+
+  // Counters are read out of the timed region.
+  if(counting)
+    _counters.start();
+
   _clocks.record(ClkStart);
   run();
   _clocks.record(ClkEnd);
+
+  if(counting)
+    _counters.stop();
 }
 
 void Benchmark::setup() { }
 void Benchmark::teardown() { }
+void Benchmark::release() { }
+
+void Benchmark::point(const std::string &label) {
+  _clocks.clear();
+  _warmup = 0;
+
+  _name = label.empty() ? _baseName : _baseName + "@" + label;
+}
 
 void Benchmark::report() {
-  typedef Benchmark::iterator clk_iterator;
-  typedef TimeStat::iterator tks_iterator;
+  log() << std::endl
+
+        << "  " << std::left << std::setw(10) << "interval" << std::right
+        << std::setw(8) << "runs"
+        << std::setw(12) << "min"
+        << std::setw(12) << "max"
+        << std::setw(12) << "mean"
+        << std::setw(12) << "median"
+        << std::setw(12) << "p90"
+        << std::setw(12) << "p99"
+        << std::setw(12) << "p99.9"
+        << std::setw(12) << "stddev"
+        << std::setw(8) << "cv"
+        << std::setw(12) << "ci95-low"
+        << std::setw(12) << "ci95-high";
+
+  // Print statistics about the time spent in each interval, in seconds.
+  for(interval_iterator i = intervals_begin(),
+                        e = intervals_end();
+                        i != e;
+                        ++i) {
+    Statistics stats = statistics(*i);
+
+    log() << std::endl
+
+          << "  " << std::left << std::setw(10) << i->name() << std::right
+          << std::setw(8) << stats.size();
+
+    if(stats.empty())
+      continue;
+
+    log() << std::scientific << std::setprecision(4)
+          << std::setw(12) << stats.min()
+          << std::setw(12) << stats.max()
+          << std::setw(12) << stats.mean()
+          << std::setw(12) << stats.median()
+          << std::setw(12) << stats.percentile(90.0)
+          << std::setw(12) << stats.percentile(99.0)
+          << std::setw(12) << stats.percentile(99.9)
+          << std::setw(12) << stats.stddev()
+          << std::fixed << std::setprecision(4)
+          << std::setw(8) << stats.cv()
+          << std::scientific << std::setprecision(4)
+          << std::setw(12) << stats.ciLow()
+          << std::setw(12) << stats.ciHigh();
+  }
+
+  // Intervals spanning few clock ticks are dominated by the clock resolution,
+  // like in STREAM checktick().
+  for(interval_iterator i = intervals_begin(),
+                        e = intervals_end();
+                        i != e;
+                        ++i) {
+    Statistics stats = statistics(*i);
+
+    if(stats.empty())
+      continue;
+
+    double ticks = stats.min() / ClockSource::resolution();
+
+    if(ticks < MIN_CLOCK_TICKS)
+      log() << std::endl
+            << "  Warning: interval '" << i->name() << "' lasts "
+            << std::fixed << std::setprecision(1) << ticks
+            << " clock ticks, timing is unreliable below "
+            << MIN_CLOCK_TICKS;
+  }
+
+  CounterSeries series = counterSeries();
+
+  if(series.empty())
+    return;
 
-  // Print all clock values.
-  for(clk_iterator i = _clocks.begin(), e = _clocks.end(); i != e; ++i)
-    for(tks_iterator j = i->begin(), f = i->end(); j != f; ++j)
-      log() << " " << std::scientific << *j;
+  // Print statistics about counters, for each run.
+  log() << std::endl
+        << std::endl
 
-  // Here we known the meaning of only the first two clocks, hence we can
-  // perform only one subtraction. Subclasses can compute other stats.
-  const TimeStat &stat = _clocks[ClkEnd] - _clocks[ClkStart];
+        << "  " << std::left << std::setw(18) << "counter" << std::right
+        << std::setw(8) << "runs"
+        << std::setw(12) << "min"
+        << std::setw(12) << "max"
+        << std::setw(12) << "median";
 
-  for(tks_iterator i = stat.begin(), e = stat.end(); i != e; ++i)
-    log() << " " << std::scientific << *i;
-  log() << " " << std::scientific << stat.avg();
+  for(CounterSeries::const_iterator i = series.begin(),
+                                    e = series.end();
+                                    i != e;
+                                    ++i) {
+    Statistics stats(i->second);
+
+    log() << std::endl
+
+          << "  " << std::left << std::setw(18) << i->first << std::right
+          << std::setw(8) << stats.size();
+
+    if(stats.empty())
+      continue;
+
+    log() << std::scientific << std::setprecision(4)
+          << std::setw(12) << stats.min()
+          << std::setw(12) << stats.max()
+          << std::setw(12) << stats.median();
+  }
+}
+
+void Benchmark::attachCounters() {
+  _counters.open();
+
+  log() << "Performance counters =";
+
+  for(PerfCounters::iterator i = _counters.begin(),
+                             e = _counters.end();
+                             i != e;
+                             ++i)
+    log() << " " << i->name();
+
+  log() << (_counters.empty() ? " none available" : "") << std::endl;
+}
+
+void Benchmark::detachCounters() {
+  _counters.close();
+
+  CounterSeries series = counterSeries();
+
+  for(CounterSeries::const_iterator i = series.begin(),
+                                    e = series.end();
+                                    i != e;
+                                    ++i) {
+    Statistics stats(i->second);
+
+    if(!stats.empty())
+      metric(i->first, stats.median());
+  }
 }
 
 std::ostream &Benchmark::log() const { return _runner->log(); }
 
+Benchmark::CounterSeries Benchmark::counterSeries() const {
+  CounterSeries series;
+
+  for(PerfCounters::iterator i = _counters.begin(),
+                             e = _counters.end();
+                             i != e;
+                             ++i)
+    series.push_back(std::make_pair(i->name(), i->samples()));
+
+  if(series.empty())
+    return series;
+
+  // Counters are read around the whole run: compare them with its duration,
+  // warm-up runs included, as counters.
+  TimeStat times = duration(*intervals_begin());
+
+  const PerfCounters::Counter *taskClock = _counters.find("task-clock"),
+                              *cycles = _counters.find("cycles"),
+                              *instrs = _counters.find("instructions"),
+                              *llcMisses = _counters.find("llc-misses"),
+                              *dtlbMisses = _counters.find("dtlb-misses"),
+                              *imcReads = _counters.find("imc-bytes-read"),
+                              *imcWrites = _counters.find("imc-bytes-written");
+
+  std::vector<double> ipc, ghz, llcMPKI, dtlbMPKI, imcMBps;
+
+  // All counters are read together.
+  size_t runs = std::min(times.size(), _counters.begin()->samples().size());
+
+  for(size_t i = 0, e = runs; i != e; ++i) {
+    if(cycles && instrs && cycles->samples()[i])
+      ipc.push_back(instrs->samples()[i] / cycles->samples()[i]);
+
+    // Task clock is in nanoseconds.
+    if(cycles && taskClock && taskClock->samples()[i])
+      ghz.push_back(cycles->samples()[i] / taskClock->samples()[i]);
+
+    if(instrs && llcMisses && instrs->samples()[i])
+      llcMPKI.push_back(llcMisses->samples()[i] * 1e3 /
+                        instrs->samples()[i]);
+
+    if(instrs && dtlbMisses && instrs->samples()[i])
+      dtlbMPKI.push_back(dtlbMisses->samples()[i] * 1e3 /
+                         instrs->samples()[i]);
+
+    if(imcReads && imcWrites && times[i])
+      imcMBps.push_back((imcReads->samples()[i] + imcWrites->samples()[i]) *
+                        1e-6 / times[i]);
+  }
+
+  addSeries(series, "ipc", ipc);
+  addSeries(series, "ghz", ghz);
+  addSeries(series, "llc-mpki", llcMPKI);
+  addSeries(series, "dtlb-mpki", dtlbMPKI);
+  addSeries(series, "imc-MBps", imcMBps);
+
+  return series;
+}
+
+void Benchmark::parameter(const std::string &nm, const std::string &value) {
+  setProperty(_parameters, Property(nm, value, false));
+}
+
+void Benchmark::parameter(const std::string &nm, double value) {
+  setProperty(_parameters, numericProperty(nm, value));
+}
+
+void Benchmark::metric(const std::string &nm, double value) {
+  setProperty(_metrics, numericProperty(nm, value));
+}
+
 #ifdef HAVE_OPENCL
 
 //
@@ -48,32 +303,27 @@ std::ostream &Benchmark::log() const { return _runner->log(); }
 //
 
 void OpenCLAdapter::allocDevices(cl_device_type devType, unsigned devsCount) {
-  typedef std::vector<cl::Platform>::iterator iterator;
-
   std::vector<cl::Platform> plats;
   cl::Platform::get(&plats);
 
-  iterator i, e;
+  // Devices of the given type, for each platform.
+  std::vector<std::vector<cl::Device> > devs(plats.size());
+  size_t found = 0;
 
-  // Look for devices of the given type.
-  for(i = plats.begin(), e = plats.end(); i != e && _devs.empty(); ++i) {
-    // Try loading devices.
+  for(unsigned i = 0, e = plats.size(); i != e; ++i) {
+    // Try loading devices. Ignore the exception, just try with the next
+    // platform.
     try {
-      i->getDevices(devType, &_devs);
-
-      if(_devs.size() < devsCount)
-        _devs.clear();
-      else
-        _devs.resize(devsCount);
-
-    // Ignore the exception, just try with the next platform.
+      plats[i].getDevices(devType, &devs[i]);
     } catch(...) {
-      _devs.clear();
+      devs[i].clear();
     }
+
+    found += devs[i].size();
   }
 
   // No devices available: error.
-  if(_devs.empty()) {
+  if(found < devsCount || !devsCount) {
     std::ostringstream os;
     os << "Cannot find "
        << devsCount << " "
@@ -82,16 +332,41 @@ void OpenCLAdapter::allocDevices(cl_device_type devType, unsigned devsCount) {
     throw std::runtime_error(os.str());
   }
 
-  // Save platform.
-  _plat = *(i - 1);
+  // Prefer taking all devices from a single platform. Otherwise, take devices
+  // from each platform in turn.
+  for(unsigned i = 0, e = plats.size(); i != e; ++i)
+    if(devs[i].size() >= devsCount) {
+      std::vector<cl::Device> single(devs[i].begin(),
+                                     devs[i].begin() + devsCount);
+
+      devs.assign(plats.size(), std::vector<cl::Device>());
+      devs[i] = single;
+      break;
+    }
+
+  for(unsigned i = 0, e = plats.size(); i != e; ++i) {
+    size_t taken = std::min<size_t>(devs[i].size(), devsCount - _devs.size());
+
+    if(!taken)
+      continue;
+
+    // Build a context for all the devices of the platform.
+    std::vector<cl::Device> platDevs(devs[i].begin(), devs[i].begin() + taken);
 
-  // Build a context for all these devices.
-  cl_context_properties props[] =
-    { CL_CONTEXT_PLATFORM,
-      reinterpret_cast<cl_context_properties>(_plat()),
-      0
-    };
-  _ctx = cl::Context(_devs, props);
+    cl_context_properties props[] =
+      { CL_CONTEXT_PLATFORM,
+        reinterpret_cast<cl_context_properties>(plats[i]()),
+        0
+      };
+
+    _plats.push_back(plats[i]);
+    _ctxs.push_back(cl::Context(platDevs, props));
+
+    _devs.insert(_devs.end(), platDevs.begin(), platDevs.end());
+    _devPlats.insert(_devPlats.end(), taken, _plats.size() - 1);
+  }
+
+  _progs.resize(_plats.size());
 }
 
 void OpenCLAdapter::clearDevices() {
@@ -99,37 +374,42 @@ void OpenCLAdapter::clearDevices() {
   // state of this object.
 
   try {
-    _ctx = cl::Context();
+    _progs.clear();
   } catch(...) { }
 
   try {
-    _plat = cl::Platform();
+    _ctxs.clear();
   } catch(...) { }
 
   try {
-    _devs.clear();
+    _plats.clear();
   } catch(...) { }
 
   try {
-    _prog = cl::Program();
+    _devs.clear();
+    _devPlats.clear();
   } catch(...) { }
 }
 
-cl::Buffer OpenCLAdapter::allocBuffer(size_t size) {
-  assert(_plat() && _ctx() && "unknown platform/context");
+cl::Buffer OpenCLAdapter::allocBuffer(size_t size, unsigned dev) {
+  assert(dev < _devs.size() && "invalid device id");
 
-  return cl::Buffer(_ctx, CL_MEM_READ_WRITE, size);
+  return cl::Buffer(_ctxs[_devPlats[dev]], CL_MEM_READ_WRITE, size);
 }
 
 cl::CommandQueue OpenCLAdapter::allocQueue(unsigned dev) {
-  assert(_plat() && _ctx() && "unknown platform/context");
   assert(dev < _devs.size() && "invalid device id");
 
-  return cl::CommandQueue(_ctx, _devs[dev]);
+  // Profiling lets benchmarks read when commands run on the device.
+  return cl::CommandQueue(_ctxs[_devPlats[dev]],
+                          _devs[dev],
+                          CL_QUEUE_PROFILING_ENABLE);
 }
 
 void OpenCLAdapter::compile(const std::string &dataDir,
-                            const std::string &file) {
+                            const std::string &file,
+                            const std::string &options,
+                            const std::string &cacheDir) {
   std::string path(dataDir + "/" + file);
   std::ifstream is(path.c_str());
 
@@ -140,28 +420,57 @@ void OpenCLAdapter::compile(const std::string &dataDir,
     throw std::runtime_error(os.str());
   }
 
-  std::string src;
+  // Note: the double '(' and ')' are really needed: do not remove!
+  std::string src((std::istreambuf_iterator<char>(is)),
+                  (std::istreambuf_iterator<char>()));
 
-  try {
-    // Note: the double '(' and ')' are really needed: do not remove!
-    std::string src((std::istreambuf_iterator<char>(is)),
-                    (std::istreambuf_iterator<char>()));
-    cl::Program::Sources srcs(1, std::make_pair(src.c_str(), 0));
+  unsigned long long start = ClockSource::read();
 
-    _prog = cl::Program(_ctx, srcs);
-    _prog.build(_devs);
+  // A program for each platform: the cache is hit if all of them are loaded.
+  std::vector<bool> built(_plats.size(), false);
 
-  } catch(...) {
-    std::ostringstream os;
-    os << "Error: cannot compile '" << path << "'";
+  _programCache = cacheDir.empty() ? CacheDisabled : CacheHit;
 
-    throw std::runtime_error(os.str());
+  for(unsigned i = 0, e = _plats.size(); i != e; ++i) {
+    if(_programCache != CacheDisabled &&
+       loadBinaries(i, cacheDir, src, options))
+      continue;
+
+    try {
+      cl::Program::Sources srcs(1, std::make_pair(src.c_str(), 0));
+
+      _progs[i] = cl::Program(_ctxs[i], srcs);
+      _progs[i].build(platformDevices(i), options.c_str());
+
+    } catch(...) {
+      std::ostringstream os;
+      os << "Error: cannot compile '" << path << "'";
+
+      if(!options.empty())
+        os << " with options '" << options << "'";
+
+      throw std::runtime_error(os.str());
+    }
+
+    built[i] = true;
+
+    if(_programCache != CacheDisabled)
+      _programCache = CacheMiss;
   }
+
+  _compileTime = (ClockSource::read() - start) * ClockSource::period();
+
+  // Storing binaries is not part of the compile time.
+  for(unsigned i = 0, e = _plats.size(); i != e; ++i)
+    if(built[i] && _programCache != CacheDisabled)
+      storeBinaries(i, cacheDir, src, options);
 }
 
-cl::Kernel OpenCLAdapter::load(const std::string &name) {
+cl::Kernel OpenCLAdapter::load(const std::string &name, unsigned dev) {
+  assert(dev < _devs.size() && "invalid device id");
+
   try {
-    return cl::Kernel(_prog, name.c_str());
+    return cl::Kernel(_progs[_devPlats[dev]], name.c_str());
 
   } catch(...) {
     std::ostringstream os;
@@ -173,13 +482,60 @@ cl::Kernel OpenCLAdapter::load(const std::string &name) {
 
 size_t OpenCLAdapter::preferredWGSizeMultiple(cl::Kernel &kernel,
                                               unsigned dev) {
-  assert(_plat() && _ctx() && "unknown platform/context");
   assert(dev < _devs.size() && "invalid device id");
 
   return kernel.getWorkGroupInfo<CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE>(
            _devs[dev]);
 }
 
+size_t OpenCLAdapter::maxWGSize(cl::Kernel &kernel, unsigned dev) {
+  assert(dev < _devs.size() && "invalid device id");
+
+  return kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(_devs[dev]);
+}
+
+unsigned OpenCLAdapter::computeUnits(unsigned dev) {
+  assert(dev < _devs.size() && "invalid device id");
+
+  return _devs[dev].getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+}
+
+std::string OpenCLAdapter::deviceName(unsigned dev) {
+  assert(dev < _devs.size() && "invalid device id");
+
+  return _devs[dev].getInfo<CL_DEVICE_NAME>();
+}
+
+std::string OpenCLAdapter::cachePath(const std::string &cacheDir,
+                                     const std::string &key,
+                                     unsigned dev,
+                                     const std::string &suffix) {
+  assert(dev < _devs.size() && "invalid device id");
+
+  std::string fields[] = {
+    key,
+    _plats[_devPlats[dev]].getInfo<CL_PLATFORM_VERSION>(),
+    _devs[dev].getInfo<CL_DEVICE_NAME>(),
+    _devs[dev].getInfo<CL_DRIVER_VERSION>()
+  };
+
+  // FNV-1a, 64 bits. Fields are separated by their terminating '\0', so that
+  // moving characters from one field to the next changes the hash.
+  unsigned long long hash = 14695981039346656037ULL;
+
+  for(unsigned i = 0; i < sizeof(fields) / sizeof(*fields); ++i)
+    for(size_t j = 0, e = fields[i].size(); j <= e; ++j) {
+      hash ^= static_cast<unsigned char>(fields[i].c_str()[j]);
+      hash *= 1099511628211ULL;
+    }
+
+  std::ostringstream os;
+  os << cacheDir << "/"
+     << std::hex << std::setfill('0') << std::setw(16) << hash << suffix;
+
+  return os.str();
+}
+
 std::string OpenCLAdapter::devTypeToString(cl_device_type devType) {
   switch(devType) {
   case CL_DEVICE_TYPE_CPU:
@@ -198,4 +554,126 @@ std::string OpenCLAdapter::devTypeToString(cl_device_type devType) {
   return os.str();
 }
 
+std::vector<cl::Device> OpenCLAdapter::platformDevices(unsigned plat) {
+  std::vector<cl::Device> devs;
+
+  for(unsigned i = 0, e = _devs.size(); i != e; ++i)
+    if(_devPlats[i] == plat)
+      devs.push_back(_devs[i]);
+
+  return devs;
+}
+
+bool OpenCLAdapter::loadBinaries(unsigned plat,
+                                 const std::string &cacheDir,
+                                 const std::string &src,
+                                 const std::string &options) {
+  std::vector<std::string> bins(_devs.size());
+  cl::Program::Binaries ptrs;
+
+  for(unsigned i = 0, e = _devs.size(); i != e; ++i) {
+    if(_devPlats[i] != plat)
+      continue;
+
+    std::string path = cachePath(cacheDir,
+                                 programKey(src, options),
+                                 i,
+                                 ".bin");
+    std::ifstream is(path.c_str(), std::ios::in | std::ios::binary);
+
+    if(!is)
+      return false;
+
+    bins[i].assign((std::istreambuf_iterator<char>(is)),
+                   (std::istreambuf_iterator<char>()));
+    if(bins[i].empty())
+      return false;
+
+    ptrs.push_back(std::make_pair(bins[i].data(), bins[i].size()));
+  }
+
+  // Binaries may be stale or corrupted: on errors, build from source.
+  try {
+    std::vector<cl::Device> devs = platformDevices(plat);
+
+    _progs[plat] = cl::Program(_ctxs[plat], devs, ptrs);
+    _progs[plat].build(devs, options.c_str());
+
+  } catch(...) {
+    _progs[plat] = cl::Program();
+    return false;
+  }
+
+  return true;
+}
+
+void OpenCLAdapter::storeBinaries(unsigned plat,
+                                  const std::string &cacheDir,
+                                  const std::string &src,
+                                  const std::string &options) {
+  // Caching is best effort: a read-only or full disk must not fail the run.
+  try {
+    cl::Program &prog = _progs[plat];
+    std::vector<size_t> sizes = prog.getInfo<CL_PROGRAM_BINARY_SIZES>();
+
+    std::vector<std::vector<char> > bins(sizes.size());
+    std::vector<char *> ptrs(sizes.size());
+
+    for(unsigned i = 0, e = sizes.size(); i != e; ++i) {
+      bins[i].resize(sizes[i] + 1);
+      ptrs[i] = &bins[i][0];
+    }
+
+    // The C++ bindings do not allocate storage for binaries: query them with
+    // the C API, which fills the buffers pointed by ptrs.
+    cl_int err = clGetProgramInfo(prog(),
+                                  CL_PROGRAM_BINARIES,
+                                  ptrs.size() * sizeof(char *),
+                                  &ptrs[0],
+                                  NULL);
+    if(err != CL_SUCCESS || sizes.size() != platformDevices(plat).size())
+      return;
+
+    // Binaries are listed in the order devices have been given to the
+    // program, that is the order of devices of the platform.
+    for(unsigned i = 0, j = 0, e = _devs.size(); i != e; ++i) {
+      if(_devPlats[i] != plat)
+        continue;
+
+      if(sizes[j])
+        storeCacheFile(cacheDir,
+                       cachePath(cacheDir, programKey(src, options), i, ".bin"),
+                       ptrs[j],
+                       sizes[j]);
+      ++j;
+    }
+
+  } catch(...) { }
+}
+
+void OpenCLAdapter::storeCacheFile(const std::string &cacheDir,
+                                   const std::string &path,
+                                   const char *data,
+                                   size_t size) {
+  // Create the directory and all its parents.
+  for(size_t i = cacheDir.find('/', 1);
+      i != std::string::npos;
+      i = cacheDir.find('/', i + 1))
+    mkdir(cacheDir.substr(0, i).c_str(), 0755);
+  mkdir(cacheDir.c_str(), 0755);
+
+  // Write to a private file, then rename it, so that concurrent runs never
+  // read a partially written file.
+  std::ostringstream tmp;
+  tmp << path << "." << getpid() << ".tmp";
+
+  std::ofstream os(tmp.str().c_str(),
+                   std::ios::out | std::ios::binary | std::ios::trunc);
+  os.write(data, size);
+  os.close();
+
+  if(!os || std::rename(tmp.str().c_str(), path.c_str()))
+    std::remove(tmp.str().c_str());
+}
+
 #endif // HAVE_OPENCL
@@ -0,0 +1,142 @@
+
+#include "florentino/clock.h"
+
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef FLORENTINO_HAVE_TSC
+#include <cpuid.h>
+#endif // FLORENTINO_HAVE_TSC
+
+using namespace florentino;
+
+namespace {
+
+// Readings used to find the resolution of the source, and to measure the cost
+// of a reading.
+const unsigned RESOLUTION_READS = 20;
+const unsigned OVERHEAD_READS = 1000;
+
+// The time stamp counter is calibrated over this many nanoseconds.
+const unsigned long long CALIBRATION_TIME = 50000000;
+
+unsigned long long monotonicTime() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * static_cast<unsigned long long>(1e9) + ts.tv_nsec;
+}
+
+#ifdef FLORENTINO_HAVE_TSC
+// Seconds per tick of the time stamp counter. The counter is read around each
+// reading of the monotonic clock, so the error is bounded by the cost of a
+// reading.
+double calibrateTSC() {
+  unsigned aux;
+
+  unsigned long long tsc0 = __rdtscp(&aux),
+                     mono0 = monotonicTime(),
+                     tsc1 = __rdtscp(&aux),
+                     mono1;
+
+  do
+    mono1 = monotonicTime();
+  while(mono1 - mono0 < CALIBRATION_TIME);
+
+  unsigned long long tsc2 = __rdtscp(&aux),
+                     mono2 = monotonicTime(),
+                     tsc3 = __rdtscp(&aux);
+
+  double start = (tsc0 + tsc1) / 2.0,
+         end = (tsc2 + tsc3) / 2.0;
+
+  return (mono2 - mono0) * 1e-9 / (end - start);
+}
+#endif // FLORENTINO_HAVE_TSC
+
+} // End anonymous namespace.
+
+//
+// ClockSource implementation.
+//
+
+ClockSource::Kind ClockSource::_kind = ClockSource::Monotonic;
+
+double ClockSource::_period = 1e-9;
+double ClockSource::_resolution = 1e-9;
+double ClockSource::_overhead = 0.0;
+
+bool ClockSource::parse(const std::string &name, Kind &kind) {
+  if(name == "monotonic")
+    kind = Monotonic;
+  else if(name == "tsc")
+    kind = TSC;
+  else if(name == "auto")
+    kind = available(TSC) ? TSC : Monotonic;
+  else
+    return false;
+
+  return true;
+}
+
+bool ClockSource::available(Kind kind) {
+  if(kind == Monotonic)
+    return true;
+
+#ifdef FLORENTINO_HAVE_TSC
+  unsigned eax, ebx, ecx, edx;
+
+  if(!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007)
+    return false;
+
+  // The counter must tick at a constant rate, whatever the power state, and
+  // rdtscp must be supported.
+  bool rdtscp = __get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx) &&
+                edx & (1 << 27);
+  bool invariant = __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) &&
+                   edx & (1 << 8);
+
+  return rdtscp && invariant;
+#else
+  return false;
+#endif // FLORENTINO_HAVE_TSC
+}
+
+void ClockSource::select(Kind kind) {
+  if(!available(kind))
+    throw std::runtime_error("Error: invariant time stamp counter "
+                             "not available");
+
+  _kind = kind;
+  _period = 1e-9;
+
+#ifdef FLORENTINO_HAVE_TSC
+  if(kind == TSC)
+    _period = calibrateTSC();
+#endif // FLORENTINO_HAVE_TSC
+
+  // Resolution is the smallest step between two different readings.
+  unsigned long long step = std::numeric_limits<unsigned long long>::max();
+
+  for(unsigned i = 0; i != RESOLUTION_READS; ++i) {
+    unsigned long long start = read(),
+                       end;
+
+    do
+      end = read();
+    while(end == start);
+
+    step = std::min(step, end - start);
+  }
+
+  _resolution = step * _period;
+
+  unsigned long long start = read();
+
+  for(unsigned i = 0; i != OVERHEAD_READS; ++i)
+    read();
+
+  _overhead = (read() - start) * _period / (OVERHEAD_READS + 1);
+}
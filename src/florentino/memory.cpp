@@ -0,0 +1,198 @@
+
+#include "florentino/memory.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <cstdio>
+
+#include <sys/mman.h>
+
+#ifdef HAVE_NUMA
+#include <numa.h>
+#endif // HAVE_NUMA
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif // MAP_HUGE_SHIFT
+
+using namespace florentino;
+
+namespace {
+
+// Static description of page policies: name, size of pages, and flags to get
+// them from mmap.
+class PagePolicyInfo {
+public:
+  const char *_name;
+  size_t _pageSize;
+  int _flags;
+};
+
+const PagePolicyInfo PagePolicies[] = {
+  { "4k", size_t(4) << 10, 0 },
+  { "thp", size_t(2) << 20, 0 },
+  { "2m", size_t(2) << 20, MAP_HUGETLB | 21 << MAP_HUGE_SHIFT },
+  { "1g", size_t(1) << 30, MAP_HUGETLB | 30 << MAP_HUGE_SHIFT }
+};
+
+// Mappings are made by whole pages.
+size_t mappingSize(size_t n, size_t size, PagePolicy policy) {
+  size_t pageSize = PagePolicies[policy]._pageSize;
+
+  return (n * size + pageSize - 1) / pageSize * pageSize;
+}
+
+std::string formatKB(size_t kb) {
+  std::ostringstream os;
+
+  if(kb >= (1 << 20) && !(kb % (1 << 20)))
+    os << (kb >> 20) << "G";
+  else if(kb >= (1 << 10) && !(kb % (1 << 10)))
+    os << (kb >> 10) << "M";
+  else
+    os << kb << "K";
+
+  return os.str();
+}
+
+} // End anonymous namespace.
+
+bool florentino::parsePagePolicy(const std::string &name, PagePolicy &policy) {
+  for(unsigned i = 0, e = sizeof(PagePolicies) / sizeof(PagePolicies[0]);
+                   i != e;
+                   ++i)
+    if(name == PagePolicies[i]._name) {
+      policy = PagePolicy(i);
+      return true;
+    }
+
+  return false;
+}
+
+const char *florentino::pagePolicyName(PagePolicy policy) {
+  return PagePolicies[policy]._name;
+}
+
+void *florentino::xpalloc(size_t n, size_t size, PagePolicy policy, int node) {
+  const PagePolicyInfo &info = PagePolicies[policy];
+  size_t length = mappingSize(n, size, policy),
+         extra = 0;
+
+  // Transparent huge pages can only back aligned 2M regions: over-allocate,
+  // and then trim the mapping.
+  if(policy == TransparentHugePages)
+    extra = info._pageSize;
+
+  void *addr = mmap(0,
+                    length + extra,
+                    PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | info._flags,
+                    -1,
+                    0);
+
+  if(addr == MAP_FAILED) {
+    std::ostringstream os;
+    os << "Error: cannot allocate " << length << " bytes on "
+       << pagePolicyName(policy) << " pages";
+
+    if(info._flags & MAP_HUGETLB)
+      os << " (are enough huge pages reserved?)";
+
+    throw std::runtime_error(os.str());
+  }
+
+  char *begin = reinterpret_cast<char *>(addr);
+
+  if(extra) {
+    size_t head = (info._pageSize -
+                   reinterpret_cast<size_t>(begin) % info._pageSize) %
+                  info._pageSize;
+
+    if(head)
+      munmap(begin, head);
+
+    if(extra - head)
+      munmap(begin + head + length, extra - head);
+
+    begin += head;
+  }
+
+  switch(policy) {
+  case SmallPages:
+    madvise(begin, length, MADV_NOHUGEPAGE);
+    break;
+
+  case TransparentHugePages:
+    madvise(begin, length, MADV_HUGEPAGE);
+    break;
+
+  default:
+    break;
+  }
+
+#ifdef HAVE_NUMA
+  if(node >= 0)
+    numa_tonode_memory(begin, length, node);
+#endif // HAVE_NUMA
+
+  return begin;
+}
+
+void florentino::xpfree(void *addr, size_t n, size_t size, PagePolicy policy) {
+  munmap(addr, mappingSize(n, size, policy));
+}
+
+std::string florentino::describePages(const void *addr) {
+  std::ifstream smaps("/proc/self/smaps");
+  std::string line;
+
+  size_t target = reinterpret_cast<size_t>(addr);
+  bool found = false;
+
+  size_t size = 0,
+         kernelPageSize = 0,
+         hugeSize = 0;
+
+  // Look for the mapping containing addr, and parse its fields, which are given
+  // in kB.
+  while(std::getline(smaps, line)) {
+    unsigned long long begin, end, value;
+    char field[64];
+
+    if(std::sscanf(line.c_str(), "%llx-%llx ", &begin, &end) == 2) {
+      if(found)
+        break;
+
+      found = begin <= target && target < end;
+
+    } else if(found &&
+              std::sscanf(line.c_str(), "%63s %llu kB", field, &value) == 2) {
+      std::string nm(field);
+
+      if(nm == "Size:")
+        size = value;
+      else if(nm == "KernelPageSize:")
+        kernelPageSize = value;
+      else if(nm == "AnonHugePages:")
+        hugeSize = value;
+    }
+  }
+
+  if(!kernelPageSize)
+    return "unknown";
+
+  std::string desc = formatKB(kernelPageSize);
+
+  // Transparent huge pages are not reported as the kernel page size.
+  if(hugeSize) {
+    std::ostringstream os;
+    os << formatKB(PagePolicies[TransparentHugePages]._pageSize >> 10)
+       << " THP (" << (size ? hugeSize * 100 / size : 0) << "%)";
+
+    desc = os.str();
+  }
+
+  return desc;
+}
@@ -2,9 +2,11 @@
 #include "florentino/option-parser.h"
 
 #include <iomanip>
+#include <limits>
 #include <sstream>
 #include <stdexcept>
 
+#include <cstdio>
 #include <cstring>
 
 #include <unistd.h>
@@ -114,3 +116,101 @@ void OptionParser::usage() const {
   // Re-use the help handler, which actually print an usage message.
   helpHandler(const_cast<OptionParser *>(this), 0);
 }
+
+//
+// Option handlers utilities.
+//
+
+bool florentino::parseSize(const std::string &str, size_t &size) {
+  std::istringstream is(str);
+  long long value;
+  char suffix;
+
+  is >> value;
+
+  if(is.fail() || value < 1)
+    return false;
+
+  if(is >> suffix) {
+    unsigned shift;
+
+    switch(suffix) {
+    case 'K': shift = 10; break;
+    case 'M': shift = 20; break;
+    case 'G': shift = 30; break;
+
+    default:
+      return false;
+    }
+
+    if(value > (std::numeric_limits<long long>::max() >> shift))
+      return false;
+
+    value <<= shift;
+  }
+
+  if(!is.eof() && is.peek() != EOF)
+    return false;
+
+  size = value;
+
+  return true;
+}
+
+bool florentino::parseSweep(const std::string &str,
+                            std::vector<size_t> &sizes) {
+  size_t first = str.find(':'),
+         second = str.find(':', first + 1);
+
+  if(second == std::string::npos || second + 2 > str.size())
+    return false;
+
+  size_t from, to, step;
+
+  if(!parseSize(str.substr(0, first), from) ||
+     !parseSize(str.substr(first + 1, second - first - 1), to) ||
+     !parseSize(str.substr(second + 2), step) ||
+     from > to)
+    return false;
+
+  char kind = str[second + 1];
+
+  if((kind != 'x' && kind != '+') || (kind == 'x' && step < 2))
+    return false;
+
+  sizes.clear();
+
+  for(size_t size = from; size <= to; ) {
+    sizes.push_back(size);
+
+    // Stop before overflowing.
+    size_t max = std::numeric_limits<size_t>::max();
+
+    if(kind == 'x' ? size > max / step : size > max - step)
+      break;
+
+    size = kind == 'x' ? size * step : size + step;
+  }
+
+  return true;
+}
+
+std::string florentino::formatSize(size_t size) {
+  const char *suffixes = "KMG";
+
+  std::ostringstream os;
+
+  if(size < 1024 || size % 1024) {
+    os << size;
+    return os.str();
+  }
+
+  size /= 1024;
+
+  for(; *(suffixes + 1) && size >= 1024 && !(size % 1024); ++suffixes)
+    size /= 1024;
+
+  os << size << *suffixes;
+
+  return os.str();
+}
@@ -0,0 +1,319 @@
+
+#include "florentino/perf-counters.h"
+
+#ifdef HAVE_PERF_EVENTS
+
+#include <fstream>
+#include <sstream>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#endif // HAVE_PERF_EVENTS
+
+using namespace florentino;
+
+#ifdef HAVE_PERF_EVENTS
+
+namespace {
+
+// Core events, counted on each thread.
+class EventInfo {
+public:
+  const char *_name;
+  unsigned _type;
+  unsigned long long _config;
+};
+
+#define CACHE_READ_MISS(C)                      \
+  (PERF_COUNT_HW_CACHE_ ## C |                  \
+   PERF_COUNT_HW_CACHE_OP_READ << 8 |           \
+   PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+
+const EventInfo CoreEvents[] = {
+  { "task-clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+  { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+  { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+  { "llc-misses", PERF_TYPE_HW_CACHE, CACHE_READ_MISS(LL) },
+  { "dtlb-misses", PERF_TYPE_HW_CACHE, CACHE_READ_MISS(DTLB) }
+};
+
+#undef CACHE_READ_MISS
+
+// Uncore events, counted on each memory controller. Each event moves a cache
+// line.
+class UncoreEventInfo {
+public:
+  const char *_name;
+  const char *_event;
+};
+
+const UncoreEventInfo ImcEvents[] = {
+  { "imc-bytes-read", "cas_count_read" },
+  { "imc-bytes-written", "cas_count_write" }
+};
+
+const char *PMUS_DIR = "/sys/bus/event_source/devices";
+const char *IMC_PMU_PREFIX = "uncore_imc";
+const double IMC_EVENT_BYTES = 64.0;
+
+int perfEventOpen(perf_event_attr &attr, pid_t pid, int cpu) {
+  return syscall(SYS_perf_event_open, &attr, pid, cpu, -1, 0);
+}
+
+perf_event_attr buildAttr(unsigned type,
+                          unsigned long long config,
+                          bool uncore) {
+  perf_event_attr attr;
+
+  std::memset(&attr, 0, sizeof(attr));
+
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+
+  // Needed to scale values, if the kernel has to multiplex counters.
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  // Unprivileged users can count only user-space events, while uncore events
+  // cannot be filtered at all.
+  if(!uncore) {
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+  }
+
+  return attr;
+}
+
+double readCounter(int fd) {
+  unsigned long long values[3];
+
+  if(read(fd, values, sizeof(values)) != sizeof(values) || !values[2])
+    return 0.0;
+
+  return values[0] * (double(values[1]) / values[2]);
+}
+
+std::vector<std::string> listDir(const std::string &path) {
+  std::vector<std::string> entries;
+
+  if(DIR *dir = opendir(path.c_str())) {
+    while(dirent *entry = readdir(dir))
+      if(entry->d_name[0] != '.')
+        entries.push_back(entry->d_name);
+
+    closedir(dir);
+  }
+
+  return entries;
+}
+
+std::string readLine(const std::string &path) {
+  std::ifstream is(path.c_str());
+  std::string line;
+
+  std::getline(is, line);
+
+  return line;
+}
+
+// Parse a list of CPUs as found in sysfs -- e.g. "0,18" or "0-3,8".
+std::vector<int> parseCPUList(const std::string &list) {
+  std::vector<int> cpus;
+  std::istringstream is(list);
+  std::string range;
+
+  while(std::getline(is, range, ',')) {
+    if(range.empty())
+      continue;
+
+    std::string::size_type dash = range.find('-');
+    int first = std::atoi(range.substr(0, dash).c_str()),
+        last = dash == std::string::npos
+               ? first
+               : std::atoi(range.substr(dash + 1).c_str());
+
+    for(int cpu = first; cpu <= last; ++cpu)
+      cpus.push_back(cpu);
+  }
+
+  return cpus;
+}
+
+// Build the config of an uncore event described in sysfs. The event is a list
+// of terms -- e.g. "event=0x04,umask=0x03" -- and the PMU format tells where
+// each term goes -- e.g. "config:8-15".
+bool uncoreConfig(const std::string &pmu,
+                  const std::string &event,
+                  unsigned long long &config) {
+  std::istringstream terms(readLine(pmu + "/events/" + event));
+  std::string term;
+
+  config = 0;
+
+  while(std::getline(terms, term, ',')) {
+    size_t eq = term.find('=');
+
+    std::string nm = term.substr(0, eq),
+                format = readLine(pmu + "/format/" + nm);
+
+    unsigned long long value = eq == std::string::npos
+                               ? 1
+                               : std::strtoull(term.c_str() + eq + 1, 0, 0);
+
+    unsigned low, high;
+
+    if(std::sscanf(format.c_str(), "config:%u-%u", &low, &high) != 2) {
+      if(std::sscanf(format.c_str(), "config:%u", &low) != 1)
+        return false;
+
+      high = low;
+    }
+
+    unsigned width = high - low + 1;
+    unsigned long long mask = width >= 64 ? ~0ULL : (1ULL << width) - 1;
+
+    config |= (value & mask) << low;
+  }
+
+  return !term.empty();
+}
+
+} // End anonymous namespace.
+
+#endif // HAVE_PERF_EVENTS
+
+//
+// PerfCounters implementation.
+//
+
+const PerfCounters::Counter *PerfCounters::find(const std::string &nm) const {
+  for(iterator i = begin(), e = end(); i != e; ++i)
+    if(i->name() == nm)
+      return &*i;
+
+  return 0;
+}
+
+void PerfCounters::open() {
+  close();
+
+  _counters.clear();
+  _open = true;
+
+#ifdef HAVE_PERF_EVENTS
+  std::vector<std::string> tids = listDir("/proc/self/task"),
+                           pmus = listDir(PMUS_DIR);
+
+  for(unsigned i = 0, e = sizeof(CoreEvents) / sizeof(CoreEvents[0]);
+                   i != e;
+                   ++i) {
+    const EventInfo &info = CoreEvents[i];
+    Counter counter(info._name, 1.0);
+
+    for(unsigned j = 0, f = tids.size(); j != f; ++j) {
+      perf_event_attr attr = buildAttr(info._type, info._config, false);
+      int fd = perfEventOpen(attr, std::atoi(tids[j].c_str()), -1);
+
+      if(fd == -1)
+        break;
+
+      counter._fds.push_back(fd);
+    }
+
+    // Only counters covering all threads are meaningful.
+    if(counter._fds.size() == tids.size()) {
+      _counters.push_back(counter);
+      continue;
+    }
+
+    for(unsigned j = 0, f = counter._fds.size(); j != f; ++j)
+      ::close(counter._fds[j]);
+  }
+
+  for(unsigned i = 0, e = sizeof(ImcEvents) / sizeof(ImcEvents[0]);
+                   i != e;
+                   ++i) {
+    const UncoreEventInfo &info = ImcEvents[i];
+    Counter counter(info._name, IMC_EVENT_BYTES);
+
+    for(unsigned j = 0, f = pmus.size(); j != f; ++j) {
+      if(pmus[j].compare(0, std::strlen(IMC_PMU_PREFIX), IMC_PMU_PREFIX))
+        continue;
+
+      std::string pmu = std::string(PMUS_DIR) + "/" + pmus[j];
+      unsigned long long config;
+
+      if(!uncoreConfig(pmu, info._event, config))
+        continue;
+
+      // Uncore events are counted on a single CPU of each package: the mask
+      // lists one CPU for each package, and their counts are added up.
+      unsigned type = std::atoi(readLine(pmu + "/type").c_str());
+      std::vector<int> cpus = parseCPUList(readLine(pmu + "/cpumask"));
+
+      perf_event_attr attr = buildAttr(type, config, true);
+
+      for(unsigned k = 0, g = cpus.size(); k != g; ++k) {
+        int fd = perfEventOpen(attr, -1, cpus[k]);
+
+        if(fd != -1)
+          counter._fds.push_back(fd);
+      }
+    }
+
+    if(!counter._fds.empty())
+      _counters.push_back(counter);
+  }
+#endif // HAVE_PERF_EVENTS
+}
+
+void PerfCounters::close() {
+  typedef std::vector<Counter>::iterator iterator;
+
+#ifdef HAVE_PERF_EVENTS
+  for(iterator i = _counters.begin(), e = _counters.end(); i != e; ++i) {
+    for(unsigned j = 0, f = i->_fds.size(); j != f; ++j)
+      ::close(i->_fds[j]);
+
+    i->_fds.clear();
+  }
+#endif // HAVE_PERF_EVENTS
+
+  _open = false;
+}
+
+void PerfCounters::start() {
+  typedef std::vector<Counter>::iterator iterator;
+
+#ifdef HAVE_PERF_EVENTS
+  for(iterator i = _counters.begin(), e = _counters.end(); i != e; ++i) {
+    i->_start = 0.0;
+
+    for(unsigned j = 0, f = i->_fds.size(); j != f; ++j)
+      i->_start += readCounter(i->_fds[j]);
+  }
+#endif // HAVE_PERF_EVENTS
+}
+
+void PerfCounters::stop() {
+  typedef std::vector<Counter>::iterator iterator;
+
+#ifdef HAVE_PERF_EVENTS
+  for(iterator i = _counters.begin(), e = _counters.end(); i != e; ++i) {
+    double value = 0.0;
+
+    for(unsigned j = 0, f = i->_fds.size(); j != f; ++j)
+      value += readCounter(i->_fds[j]);
+
+    i->_samples.push_back((value - i->_start) * i->_scale);
+  }
+#endif // HAVE_PERF_EVENTS
+}
@@ -0,0 +1,254 @@
+
+#include "florentino/result-sink.h"
+
+#include <iomanip>
+#include <sstream>
+
+#include <ctime>
+
+#include <unistd.h>
+
+using namespace florentino;
+
+namespace {
+
+// Samples are in seconds: 10 significant digits are more than enough to
+// preserve clock resolution.
+const int SAMPLE_PRECISION = 10;
+
+std::string hostName() {
+  char buf[256];
+
+  if(gethostname(buf, sizeof(buf)))
+    return "unknown";
+
+  buf[sizeof(buf) - 1] = '\0';
+
+  return buf;
+}
+
+// Current time, in ISO 8601 format, UTC.
+std::string currentDate() {
+  std::time_t now = std::time(0);
+  std::tm utc;
+  char buf[32];
+
+  gmtime_r(&now, &utc);
+  std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", &utc);
+
+  return buf;
+}
+
+std::string jsonString(const std::string &str) {
+  std::ostringstream os;
+
+  os << '"';
+
+  for(std::string::const_iterator i = str.begin(),
+                                  e = str.end();
+                                  i != e;
+                                  ++i) {
+    switch(*i) {
+    case '"':
+      os << "\\\"";
+      break;
+
+    case '\\':
+      os << "\\\\";
+      break;
+
+    case '\n':
+      os << "\\n";
+      break;
+
+    case '\t':
+      os << "\\t";
+      break;
+
+    default:
+      if(static_cast<unsigned char>(*i) < 0x20)
+        os << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+           << static_cast<unsigned>(*i);
+      else
+        os << *i;
+    }
+  }
+
+  os << '"';
+
+  return os.str();
+}
+
+std::string jsonValue(const Benchmark::Property &prop) {
+  return prop.numeric() ? prop.value() : jsonString(prop.value());
+}
+
+// Quote a field only if needed, doubling embedded quotes as RFC 4180 says.
+std::string csvField(const std::string &str) {
+  if(str.find_first_of(",\"\n") == std::string::npos)
+    return str;
+
+  std::string quoted("\"");
+
+  for(std::string::const_iterator i = str.begin(),
+                                  e = str.end();
+                                  i != e;
+                                  ++i) {
+    if(*i == '"')
+      quoted += '"';
+
+    quoted += *i;
+  }
+
+  return quoted + '"';
+}
+
+} // End anonymous namespace.
+
+//
+// ResultSink implementation.
+//
+
+ResultSink *ResultSink::create(const std::string &format, std::ostream &os) {
+  if(format == "json")
+    return new JSONResultSink(os);
+
+  if(format == "csv")
+    return new CSVResultSink(os);
+
+  return 0;
+}
+
+//
+// JSONResultSink implementation.
+//
+
+void JSONResultSink::begin(const std::string &command) {
+  _os << "{" << std::endl
+      << "  \"host\": " << jsonString(hostName()) << "," << std::endl
+      << "  \"date\": " << jsonString(currentDate()) << "," << std::endl
+      << "  \"command\": " << jsonString(command) << "," << std::endl
+      << "  \"benchmarks\": [";
+}
+
+void JSONResultSink::write(const Benchmark &bench) {
+  typedef Benchmark::property_iterator property_iterator;
+  typedef Benchmark::interval_iterator interval_iterator;
+
+  _os << (_benchmarks++ ? "," : "") << std::endl
+      << "    {" << std::endl
+      << "      \"name\": " << jsonString(bench.name()) << "," << std::endl
+      << "      \"runs\": " << bench.runs() << "," << std::endl
+      << "      \"warmup\": " << bench.warmup() << "," << std::endl;
+
+  _os << "      \"parameters\": {";
+
+  for(property_iterator i = bench.parameters_begin(),
+                        b = i,
+                        e = bench.parameters_end();
+                        i != e;
+                        ++i)
+    _os << (i == b ? "" : ",") << std::endl
+        << "        " << jsonString(i->name()) << ": " << jsonValue(*i);
+
+  _os << std::endl
+      << "      }," << std::endl;
+
+  _os << "      \"metrics\": {";
+
+  for(property_iterator i = bench.metrics_begin(),
+                        b = i,
+                        e = bench.metrics_end();
+                        i != e;
+                        ++i)
+    _os << (i == b ? "" : ",") << std::endl
+        << "        " << jsonString(i->name()) << ": " << jsonValue(*i);
+
+  _os << std::endl
+      << "      }," << std::endl;
+
+  _os << "      \"intervals\": [";
+
+  for(interval_iterator i = bench.intervals_begin(),
+                        b = i,
+                        e = bench.intervals_end();
+                        i != e;
+                        ++i) {
+    TimeStat samples = bench.duration(*i);
+
+    _os << (i == b ? "" : ",") << std::endl
+        << "        {" << std::endl
+        << "          \"name\": " << jsonString(i->name()) << "," << std::endl
+        << "          \"samples\": ["
+        << std::setprecision(SAMPLE_PRECISION);
+
+    for(size_t j = 0, f = samples.size(); j != f; ++j)
+      _os << (j ? ", " : "") << double(samples[j]);
+
+    _os << "]" << std::endl
+        << "        }";
+  }
+
+  _os << std::endl
+      << "      ]" << std::endl
+      << "    }";
+}
+
+void JSONResultSink::end() {
+  _os << std::endl
+      << "  ]" << std::endl
+      << "}" << std::endl;
+}
+
+//
+// CSVResultSink implementation.
+//
+
+void CSVResultSink::begin(const std::string &command) {
+  _os << "benchmark,record,name,run,value" << std::endl
+      << ",metadata,host,," << csvField(hostName()) << std::endl
+      << ",metadata,date,," << csvField(currentDate()) << std::endl
+      << ",metadata,command,," << csvField(command) << std::endl;
+}
+
+void CSVResultSink::write(const Benchmark &bench) {
+  typedef Benchmark::property_iterator property_iterator;
+  typedef Benchmark::interval_iterator interval_iterator;
+
+  std::string name = csvField(bench.name());
+
+  _os << name << ",metadata,runs,," << bench.runs() << std::endl
+      << name << ",metadata,warmup,," << bench.warmup() << std::endl;
+
+  for(property_iterator i = bench.parameters_begin(),
+                        e = bench.parameters_end();
+                        i != e;
+                        ++i)
+    _os << name << ",parameter," << csvField(i->name()) << ",,"
+        << csvField(i->value()) << std::endl;
+
+  for(property_iterator i = bench.metrics_begin(),
+                        e = bench.metrics_end();
+                        i != e;
+                        ++i)
+    _os << name << ",metric," << csvField(i->name()) << ",,"
+        << csvField(i->value()) << std::endl;
+
+  _os << std::setprecision(SAMPLE_PRECISION);
+
+  for(interval_iterator i = bench.intervals_begin(),
+                        e = bench.intervals_end();
+                        i != e;
+                        ++i) {
+    TimeStat samples = bench.duration(*i);
+    std::string interval = csvField(i->name());
+
+    for(size_t j = 0, f = samples.size(); j != f; ++j)
+      _os << name << ",sample," << interval << "," << j << ","
+          << double(samples[j]) << std::endl;
+  }
+}
+
+void CSVResultSink::end() {
+  _os.flush();
+}
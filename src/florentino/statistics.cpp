@@ -0,0 +1,215 @@
+
+#include "florentino/statistics.h"
+#include "florentino/random.h"
+
+#include <algorithm>
+
+#include <cmath>
+
+using namespace florentino;
+
+namespace {
+
+// Two-sided critical value of the standard normal distribution for the used
+// confidence level.
+const double Z_CRITICAL = 1.959964;
+
+} // End anonymous namespace.
+
+//
+// Statistics implementation.
+//
+
+const double Statistics::CONFIDENCE = 0.95;
+const unsigned Statistics::BOOTSTRAP_RESAMPLES = 1000;
+const size_t Statistics::BOOTSTRAP_MAX_SAMPLES = 10000;
+
+Statistics::Statistics(const TimeStat &stat, size_t skip)
+  : _sorted(stat.begin() + std::min(skip, stat.size()), stat.end()),
+    _mean(0.0),
+    _stddev(0.0),
+    _ciLow(0.0),
+    _ciHigh(0.0) {
+  compute();
+}
+
+Statistics::Statistics(const TimeStat &to, const TimeStat &from, size_t skip)
+  : _mean(0.0),
+    _stddev(0.0),
+    _ciLow(0.0),
+    _ciHigh(0.0) {
+  size_t n = std::min(to.size(), from.size());
+
+  if(skip < n)
+    _sorted.reserve(n - skip);
+
+  for(size_t i = skip; i < n; ++i)
+    _sorted.push_back(to[i] - from[i]);
+
+  compute();
+}
+
+Statistics::Statistics(const std::vector<double> &samples, size_t skip)
+  : _sorted(samples.begin() + std::min(skip, samples.size()), samples.end()),
+    _mean(0.0),
+    _stddev(0.0),
+    _ciLow(0.0),
+    _ciHigh(0.0) {
+  compute();
+}
+
+size_t Statistics::warmup(const TimeStat &stat) {
+  size_t n = stat.size();
+
+  if(n < 4)
+    return 0;
+
+  // Suffix sums of samples and of their squares, so the statistic of each
+  // truncation point is computed in constant time.
+  std::vector<double> sums(n + 1, 0.0),
+                      squares(n + 1, 0.0);
+
+  for(size_t i = n; i != 0; --i) {
+    double x = stat[i - 1];
+
+    sums[i - 1] = sums[i] + x;
+    squares[i - 1] = squares[i] + x * x;
+  }
+
+  size_t best = 0;
+  double bestStat = 0.0;
+
+  for(size_t d = 0, e = n / 2; d <= e; ++d) {
+    double kept = n - d,
+           deviation = squares[d] - sums[d] * sums[d] / kept,
+           mser = deviation / (kept * kept);
+
+    if(d == 0 || mser < bestStat) {
+      best = d;
+      bestStat = mser;
+    }
+  }
+
+  return best;
+}
+
+double Statistics::mannWhitney(const Statistics &a, const Statistics &b) {
+  const std::vector<double> &x = a._sorted,
+                            &y = b._sorted;
+
+  double n = x.size(),
+         m = y.size();
+
+  if(!n || !m)
+    return 1.0;
+
+  // Both samples are sorted: merge them, assigning to each group of ties the
+  // average of their ranks.
+  double rankSum = 0.0,
+         ties = 0.0;
+
+  size_t i = 0, j = 0;
+
+  while(i != x.size() || j != y.size()) {
+    double value = j == y.size() || (i != x.size() && x[i] < y[j]) ? x[i]
+                                                                    : y[j];
+    size_t first = i + j + 1,
+           inY = 0;
+
+    while(i != x.size() && x[i] == value)
+      ++i;
+
+    while(j != y.size() && y[j] == value) {
+      ++j;
+      ++inY;
+    }
+
+    double count = i + j + 1 - first,
+           rank = first + (count - 1) / 2.0;
+
+    rankSum += rank * inY;
+    ties += count * count * count - count;
+  }
+
+  double u = rankSum - m * (m + 1) / 2.0,
+         total = n + m,
+         mean = n * m / 2.0,
+         variance = n * m / 12.0 * ((total + 1) - ties / (total * (total - 1)));
+
+  // All samples are equal: no evidence at all.
+  if(variance <= 0.0)
+    return 1.0;
+
+  // Continuity correction.
+  double z = (u - mean - 0.5) / std::sqrt(variance);
+
+  return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+double Statistics::percentile(double p) const {
+  assert(!_sorted.empty() && "no samples");
+  assert(p >= 0.0 && p <= 100.0 && "invalid percentile");
+
+  double rank = p / 100.0 * (_sorted.size() - 1);
+  size_t lower = static_cast<size_t>(rank);
+
+  if(lower + 1 >= _sorted.size())
+    return _sorted.back();
+
+  double weight = rank - lower;
+
+  return _sorted[lower] * (1.0 - weight) + _sorted[lower + 1] * weight;
+}
+
+void Statistics::compute() {
+  if(_sorted.empty())
+    return;
+
+  // Welford's algorithm: a single, numerically stable, pass.
+  double m2 = 0.0;
+
+  for(size_t i = 0, e = _sorted.size(); i != e; ++i) {
+    double delta = _sorted[i] - _mean;
+
+    _mean += delta / (i + 1);
+    m2 += delta * (_sorted[i] - _mean);
+  }
+
+  if(_sorted.size() > 1)
+    _stddev = std::sqrt(m2 / (_sorted.size() - 1));
+
+  if(_sorted.size() <= BOOTSTRAP_MAX_SAMPLES) {
+    bootstrap();
+  } else {
+    double halfWidth = Z_CRITICAL * _stddev / std::sqrt(double(size()));
+
+    _ciLow = _mean - halfWidth;
+    _ciHigh = _mean + halfWidth;
+  }
+
+  std::sort(_sorted.begin(), _sorted.end());
+}
+
+void Statistics::bootstrap() {
+  std::vector<double> means(BOOTSTRAP_RESAMPLES);
+  Random random;
+
+  size_t n = _sorted.size();
+
+  for(unsigned i = 0, e = BOOTSTRAP_RESAMPLES; i != e; ++i) {
+    double sum = 0.0;
+
+    for(size_t j = 0; j != n; ++j)
+      sum += _sorted[random(n)];
+
+    means[i] = sum / n;
+  }
+
+  std::sort(means.begin(), means.end());
+
+  double tail = (1.0 - CONFIDENCE) / 2.0;
+
+  _ciLow = means[static_cast<size_t>(tail * (BOOTSTRAP_RESAMPLES - 1))];
+  _ciHigh = means[static_cast<size_t>((1.0 - tail) *
+                                      (BOOTSTRAP_RESAMPLES - 1))];
+}
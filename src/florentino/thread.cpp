@@ -0,0 +1,174 @@
+
+#include "florentino/thread.h"
+
+#include <sstream>
+#include <stdexcept>
+
+#include <cstring>
+
+#include <sched.h>
+
+using namespace florentino;
+
+//
+// ThreadTeam implementation.
+//
+
+ThreadTeam::ThreadTeam(const std::vector<unsigned> &cpus) : _cpus(cpus),
+                                                            _startup(Starting),
+                                                            _routine(0),
+                                                            _arg(0) {
+  assert(!_cpus.empty() && "empty thread team");
+
+  pthread_mutex_init(&_startupLock, 0);
+  pthread_cond_init(&_startupCond, 0);
+
+  pthread_barrier_init(&_start, 0, _cpus.size());
+  pthread_barrier_init(&_done, 0, _cpus.size());
+
+  // The master is pinned too, but its mask is restored on team destruction.
+  pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &_masterMask);
+
+  cpu_set_t mask;
+
+  CPU_ZERO(&mask);
+  CPU_SET(_cpus[0], &mask);
+  pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &mask);
+
+  // Members must be allocated before starting threads, the vector must not be
+  // resized while other threads are reading it.
+  _members.reserve(_cpus.size());
+  for(unsigned i = 0, e = _cpus.size(); i != e; ++i)
+    _members.push_back(Member(this, i));
+
+  for(unsigned i = 1, e = _cpus.size(); i != e; ++i) {
+    pthread_attr_t attr;
+
+    CPU_ZERO(&mask);
+    CPU_SET(_cpus[i], &mask);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &mask);
+
+    int err = pthread_create(&_members[i]._thread, &attr, member, &_members[i]);
+
+    pthread_attr_destroy(&attr);
+
+    if(err) {
+      // Only members up to the failed one are running.
+      _members.resize(i);
+      startup(false);
+
+      std::ostringstream os;
+      os << "Error: cannot start thread on CPU " << _cpus[i] << ": "
+         << std::strerror(err);
+
+      throw std::runtime_error(os.str());
+    }
+  }
+
+  startup(true);
+}
+
+ThreadTeam::~ThreadTeam() {
+  // A null routine tells members to exit.
+  _routine = 0;
+  pthread_barrier_wait(&_start);
+
+  for(unsigned i = 1, e = _members.size(); i != e; ++i)
+    pthread_join(_members[i]._thread, 0);
+
+  pthread_barrier_destroy(&_start);
+  pthread_barrier_destroy(&_done);
+
+  pthread_cond_destroy(&_startupCond);
+  pthread_mutex_destroy(&_startupLock);
+
+  pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &_masterMask);
+}
+
+void ThreadTeam::run(Routine routine, void *arg) {
+  assert(routine && "invalid routine");
+
+  _routine = routine;
+  _arg = arg;
+
+  pthread_barrier_wait(&_start);
+  _routine(_arg, 0, size());
+  pthread_barrier_wait(&_done);
+}
+
+std::vector<unsigned> ThreadTeam::availableCPUs() {
+  std::vector<unsigned> cpus;
+  cpu_set_t mask;
+
+  pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &mask);
+
+  for(unsigned i = 0, e = CPU_SETSIZE; i != e; ++i)
+    if(CPU_ISSET(i, &mask))
+      cpus.push_back(i);
+
+  return cpus;
+}
+
+std::vector<unsigned> ThreadTeam::spread(const std::vector<unsigned> &cpus,
+                                         unsigned count) {
+  assert(!cpus.empty() && "no CPUs available");
+
+  std::vector<unsigned> team(count);
+
+  for(unsigned i = 0, e = count; i != e; ++i)
+    team[i] = cpus[i % cpus.size()];
+
+  return team;
+}
+
+void ThreadTeam::startup(bool started) {
+  pthread_mutex_lock(&_startupLock);
+  _startup = started ? Started : Aborted;
+  pthread_cond_broadcast(&_startupCond);
+  pthread_mutex_unlock(&_startupLock);
+
+  if(started)
+    return;
+
+  // The destructor is not run when the constructor throws: release everything
+  // here.
+  for(unsigned i = 1, e = _members.size(); i != e; ++i)
+    pthread_join(_members[i]._thread, 0);
+
+  pthread_barrier_destroy(&_start);
+  pthread_barrier_destroy(&_done);
+
+  pthread_cond_destroy(&_startupCond);
+  pthread_mutex_destroy(&_startupLock);
+
+  pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &_masterMask);
+}
+
+void *ThreadTeam::member(void *arg) {
+  Member *self = reinterpret_cast<Member *>(arg);
+  ThreadTeam *team = self->_team;
+
+  pthread_mutex_lock(&team->_startupLock);
+  while(team->_startup == Starting)
+    pthread_cond_wait(&team->_startupCond, &team->_startupLock);
+  bool aborted = team->_startup == Aborted;
+  pthread_mutex_unlock(&team->_startupLock);
+
+  if(aborted)
+    return 0;
+
+  while(true) {
+    pthread_barrier_wait(&team->_start);
+
+    if(!team->_routine)
+      break;
+
+    team->_routine(team->_arg, self->_id, team->size());
+
+    pthread_barrier_wait(&team->_done);
+  }
+
+  return 0;
+}
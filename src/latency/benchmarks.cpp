@@ -0,0 +1,397 @@
+
+#include "benchmarks.h"
+#include "loaded-latency.h"
+
+#include "florentino/statistics.h"
+#include "florentino/thread.h"
+
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#include <unistd.h>
+
+using namespace florentino;
+
+namespace {
+
+void workingSetHandler(void *arg, const char *optArg) {
+  std::vector<size_t> *workingSets =
+    reinterpret_cast<std::vector<size_t> *>(arg);
+
+  std::string value(optArg);
+  size_t size;
+
+  if(value.find(':') != std::string::npos) {
+    if(parseSweep(value, *workingSets))
+      return;
+
+  } else if(parseSize(value, size)) {
+    workingSets->assign(1, size);
+    return;
+  }
+
+  std::ostringstream os;
+  os << "Error: option '-l' expects a positive size, or a sweep "
+        "FROM:TO:xF or FROM:TO:+S, got '" << optArg << "'";
+
+  throw std::runtime_error(os.str());
+}
+
+void loadedHandler(void *arg, const char *optArg) {
+  bool *loaded = reinterpret_cast<bool *>(arg);
+
+  *loaded = true;
+}
+
+bool parseDelays(const std::string &str, std::vector<unsigned> &delays) {
+  std::istringstream is(str);
+  std::vector<unsigned> values;
+
+  // Parse to signed type to prevent negative delays.
+  int value;
+
+  do {
+    is >> value;
+
+    if(is.fail() || value < 0)
+      return false;
+
+    values.push_back(value);
+  } while(is.get() == ',');
+
+  if(!is.eof())
+    return false;
+
+  delays.swap(values);
+
+  return true;
+}
+
+void delaysHandler(void *arg, const char *optArg) {
+  std::vector<unsigned> *delays =
+    reinterpret_cast<std::vector<unsigned> *>(arg);
+
+  if(!parseDelays(optArg, *delays)) {
+    std::ostringstream os;
+    os << "Error: option '-D' expects a comma-separated list of non-negative "
+          "numbers, got '" << optArg << "'";
+
+    throw std::runtime_error(os.str());
+  }
+}
+
+void trafficThreadsHandler(void *arg, const char *optArg) {
+  unsigned int *trafficThreads = reinterpret_cast<unsigned int *>(arg);
+
+  // Parse to signed type to prevent negative sizes.
+  int value;
+
+  std::istringstream is(optArg);
+  is >> value;
+
+  if(is.fail() || !is.eof() || value < 1) {
+    std::ostringstream os;
+    os << "Error: option '-j' expects a positive number, "
+          "got '" << optArg << "'";
+
+    throw std::runtime_error(os.str());
+  }
+
+  *trafficThreads = value;
+}
+
+void isaHandler(void *arg, const char *optArg) {
+  std::string *isa = reinterpret_cast<std::string *>(arg);
+
+  *isa = optArg;
+}
+
+// Name of the smallest cache the working set fits in, according to the C
+// library. If sizes are not known, 0 is returned.
+const char *cacheLevel(size_t workingSet) {
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+  const int Sizes[] = { _SC_LEVEL1_DCACHE_SIZE,
+                        _SC_LEVEL2_CACHE_SIZE,
+                        _SC_LEVEL3_CACHE_SIZE,
+                        _SC_LEVEL4_CACHE_SIZE };
+  const char *Names[] = { "L1", "L2", "L3", "L4" };
+
+  bool known = false;
+
+  for(unsigned i = 0, e = sizeof(Sizes) / sizeof(Sizes[0]); i != e; ++i) {
+    long size = sysconf(Sizes[i]);
+
+    if(size <= 0)
+      continue;
+
+    known = true;
+
+    if(workingSet <= static_cast<size_t>(size))
+      return Names[i];
+  }
+
+  return known ? "DRAM" : 0;
+#else
+  return 0;
+#endif // _SC_LEVEL1_DCACHE_SIZE
+}
+
+} // End anonymous namespace.
+
+//
+// LatencyBenchmarkRunner implementation.
+//
+
+const std::string LatencyBenchmarkRunner::DEFAULT_WORKING_SETS
+  = "4K:256M:x2";
+const size_t LatencyBenchmarkRunner::DEFAULT_LOADS
+  = size_t(1) << 22;
+const std::string LatencyBenchmarkRunner::DEFAULT_DELAYS
+  = "0,50,100,200,400,800,1600,3200,6400,12800,25600";
+const std::string LatencyBenchmarkRunner::DEFAULT_ISA
+  = "auto";
+
+LatencyBenchmarkRunner::LatencyBenchmarkRunner(int argc, char *argv[])
+  : BenchmarkRunner(argc, argv),
+    _workingSet(0),
+    _loaded(DEFAULT_LOADED),
+    _delay(0),
+    _isa(DEFAULT_ISA) {
+  parseSweep(DEFAULT_WORKING_SETS, _workingSets);
+  parseDelays(DEFAULT_DELAYS, _delays);
+
+  // By default, all the other CPUs generate traffic.
+  _trafficThreads = std::max<size_t>(ThreadTeam::availableCPUs().size(), 2)
+                    - 1;
+
+  add(Option('l', Option::REQUIRED_ARGUMENT,
+             workingSetHandler, &_workingSets,
+             "-l L", "set working set to L bytes, or sweep FROM:TO:xF"));
+  add(Option('L', Option::NO_ARGUMENT,
+             loadedHandler, &_loaded,
+             "-L", "measure latency while other threads stream memory"));
+  add(Option('D', Option::REQUIRED_ARGUMENT,
+             delaysHandler, &_delays,
+             "-D D", "with -L, sweep traffic injection delays D (D1,D2,...)"));
+  add(Option('j', Option::REQUIRED_ARGUMENT,
+             trafficThreadsHandler, &_trafficThreads,
+             "-j J", "with -L, generate traffic with J threads"));
+  add(Option('i', Option::REQUIRED_ARGUMENT,
+             isaHandler, &_isa,
+             "-i I", "with -L, generate traffic with I (scalar, sse2, "
+                     "avx2, avx512, auto) kernels"));
+}
+
+unsigned LatencyBenchmarkRunner::pointsCount() const {
+  return _loaded ? _delays.size() : _workingSets.size();
+}
+
+std::string LatencyBenchmarkRunner::selectPoint(unsigned i) {
+  if(_loaded) {
+    std::ostringstream os;
+    os << "delay=" << _delays[i];
+
+    _workingSet = maxWorkingSet();
+    _delay = _delays[i];
+
+    return os.str();
+  }
+
+  _workingSet = _workingSets[i];
+
+  return sweep() ? formatSize(_workingSet) : "";
+}
+
+void LatencyBenchmarkRunner::summarize() {
+  if(_loaded) {
+    summarizeLoaded();
+    return;
+  }
+
+  if(!sweep())
+    return;
+
+  for(iterator i = begin(), e = end(); i != e; ++i) {
+    LatencyBench *bench = dynamic_cast<LatencyBench *>(*i);
+
+    if(!bench || bench->sweep_begin() == bench->sweep_end())
+      continue;
+
+    // The benchmark is now named after the last point.
+    std::string name = bench->name();
+    name.erase(name.rfind('@'));
+
+    log() << hline
+
+          << name << " latency (ns/load) by working set:"
+          << std::endl
+
+          << std::setw(12) << "working-set"
+          << std::setw(8) << "level"
+          << std::setw(12) << "median"
+          << std::setw(12) << "best"
+          << std::endl;
+
+    // The latency of a level is the one of the largest working set filling at
+    // most half of it: near full capacity, some loads hit the next level.
+    std::vector<LatencyBench::sweep_iterator> levels;
+
+    for(LatencyBench::sweep_iterator j = bench->sweep_begin(),
+                                     f = bench->sweep_end();
+                                     j != f;
+                                     ++j) {
+      const char *level = cacheLevel(j->_workingSet);
+
+      log() << std::setw(12) << formatSize(j->_workingSet)
+            << std::setw(8) << (level ? level : "-")
+            << std::fixed << std::setprecision(2)
+            << std::setw(12) << j->_median
+            << std::setw(12) << j->_best
+            << std::endl;
+
+      const char *home = cacheLevel(2 * j->_workingSet);
+
+      if(!home)
+        continue;
+
+      if(levels.empty() || cacheLevel(2 * levels.back()->_workingSet) != home)
+        levels.push_back(j);
+      else
+        levels.back() = j;
+    }
+
+    if(levels.empty())
+      continue;
+
+    log() << hline
+
+          << name << " latency (ns/load) by memory level:"
+          << std::endl;
+
+    for(unsigned j = 0, f = levels.size(); j != f; ++j)
+      log() << std::setw(12) << cacheLevel(2 * levels[j]->_workingSet)
+            << std::fixed << std::setprecision(2)
+            << std::setw(12) << levels[j]->_median
+            << "  (" << formatSize(levels[j]->_workingSet) << " working set)"
+            << std::endl;
+  }
+
+  log() << hline;
+}
+
+void LatencyBenchmarkRunner::summarizeLoaded() {
+  for(iterator i = begin(), e = end(); i != e; ++i) {
+    LoadedLatency *bench = dynamic_cast<LoadedLatency *>(*i);
+
+    if(!bench || bench->curve_begin() == bench->curve_end())
+      continue;
+
+    // The benchmark is now named after the last point.
+    std::string name = bench->name();
+    name.erase(name.rfind('@'));
+
+    // Unloaded latency is approximated by the lowest one measured. The knee is
+    // the highest bandwidth sustained before latency doubles: past it, requests
+    // queue in the memory controllers.
+    double base = bench->curve_begin()->_median;
+
+    for(LoadedLatency::curve_iterator j = bench->curve_begin(),
+                                      f = bench->curve_end();
+                                      j != f;
+                                      ++j)
+      base = std::min(base, j->_median);
+
+    LoadedLatency::curve_iterator knee = bench->curve_end();
+
+    for(LoadedLatency::curve_iterator j = bench->curve_begin(),
+                                      f = bench->curve_end();
+                                      j != f;
+                                      ++j)
+      if(j->_median <= 2 * base &&
+         (knee == f || j->_bandwidth > knee->_bandwidth))
+        knee = j;
+
+    log() << hline
+
+          << name << " latency (ns/load) by traffic bandwidth:"
+          << std::endl
+
+          << std::setw(10) << "delay"
+          << std::setw(16) << "bandwidth-MBps"
+          << std::setw(12) << "median"
+          << std::setw(12) << "best"
+          << std::endl;
+
+    for(LoadedLatency::curve_iterator j = bench->curve_begin(),
+                                      f = bench->curve_end();
+                                      j != f;
+                                      ++j)
+      log() << std::setw(10) << j->_delay
+            << std::fixed << std::setprecision(1)
+            << std::setw(16) << j->_bandwidth
+            << std::setprecision(2)
+            << std::setw(12) << j->_median
+            << std::setw(12) << j->_best
+            << (j == knee ? "  <- knee" : "")
+            << std::endl;
+  }
+
+  log() << hline;
+}
+
+//
+// LatencyBench implementation.
+//
+
+void LatencyBench::setup() {
+  _chainLength = build();
+
+  log() << hline
+
+        << "Working set = " << formatSize(workingSet()) << " bytes"
+        << std::endl
+        << "Chain length = " << _chainLength
+        << std::endl
+        << "Loads per run = " << loads()
+        << std::endl
+
+        << hline;
+
+  parameter("working-set", workingSet());
+  parameter("chain-length", _chainLength);
+  parameter("loads", loads());
+
+  // Cold run: bring the working set as close as possible to the CPU.
+  chase(_chainLength);
+}
+
+void LatencyBench::run() {
+  chase(loads());
+}
+
+void LatencyBench::teardown() {
+  Statistics stats(_clocks[ClkEnd], _clocks[ClkStart], warmup());
+
+  SweepPoint point;
+  point._workingSet = workingSet();
+  point._best = stats.min() * 1e9 / loads();
+  point._median = stats.median() * 1e9 / loads();
+
+  _sweep.push_back(point);
+
+  metric("latency-best-ns", point._best);
+  metric("latency-median-ns", point._median);
+
+  log() << "Latency = "
+        << std::fixed << std::setprecision(2)
+        << point._median << " ns/load (median), "
+        << point._best << " ns/load (best)"
+        << std::endl
+
+        << hline;
+}
+
+size_t LatencyBench::loads() const {
+  return std::max(LatencyBenchmarkRunner::DEFAULT_LOADS, _chainLength);
+}
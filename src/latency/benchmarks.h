@@ -0,0 +1,150 @@
+
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include "florentino/benchmark-runner.h"
+
+#include <algorithm>
+
+// Memory latency benchmarks. Loads are made dependent on each other, by chasing
+// pointers, so the time of each load cannot be hidden by issuing the next ones.
+// Working sets of different sizes give the latency of each level of the memory
+// hierarchy.
+namespace florentino {
+
+class LatencyBenchmarkRunner : public BenchmarkRunner {
+public:
+  static const std::string DEFAULT_WORKING_SETS;
+  static const size_t DEFAULT_LOADS;
+
+  static const bool DEFAULT_LOADED = false;
+  static const std::string DEFAULT_DELAYS;
+  static const std::string DEFAULT_ISA;
+
+public:
+  LatencyBenchmarkRunner(int argc, char *argv[]);
+
+public:
+  // Size, in bytes, of the memory region accessed by the benchmark. By
+  // default, a sweep from a working set fitting in the L1 cache to one
+  // exceeding the LLC is performed. This is the size used by the current point
+  // of the sweep.
+  size_t workingSet() const { return _workingSet; }
+
+  // The largest working set of the sweep. Benchmarks allocate memory once, and
+  // reuse it at every point.
+  size_t maxWorkingSet() const {
+    return *std::max_element(_workingSets.begin(), _workingSets.end());
+  }
+
+  bool sweep() const { return _workingSets.size() > 1; }
+
+  // Whether latency is measured while other threads stream memory. In this
+  // mode, the sweep goes through injection delays rather than working sets,
+  // and the largest working set is always used.
+  bool loaded() const { return _loaded; }
+
+  // Busy-wait iterations each traffic thread performs between two blocks of
+  // streamed memory. This is the delay used by the current point.
+  unsigned delay() const { return _delay; }
+
+  // Threads generating traffic, in addition to the measuring thread.
+  unsigned trafficThreads() const { return _trafficThreads; }
+
+  // ISA of the kernels used to generate traffic.
+  const std::string &isa() const { return _isa; }
+
+protected:
+  virtual unsigned pointsCount() const;
+  virtual std::string selectPoint(unsigned i);
+
+  virtual void summarize();
+
+private:
+  void summarizeLoaded();
+
+private:
+  std::vector<size_t> _workingSets;
+  size_t _workingSet;
+
+  bool _loaded;
+  std::vector<unsigned> _delays;
+  unsigned _delay;
+  unsigned _trafficThreads;
+  std::string _isa;
+};
+
+// Drives execution of a latency benchmark: each run performs a fixed number of
+// dependent loads. Subclasses must build the chain of loads over the current
+// working set, and follow it.
+class LatencyBench : public Benchmark {
+protected:
+  LatencyBench(const std::string &nm, LatencyBenchmarkRunner &runner)
+    : Benchmark(nm, runner),
+      _chainLength(0) { }
+
+public:
+  virtual void setup();
+  virtual void run();
+  virtual void teardown();
+
+public:
+  size_t workingSet() const {
+    LatencyBenchmarkRunner &runner =
+      Benchmark::runner<LatencyBenchmarkRunner>();
+    return runner.workingSet();
+  }
+
+  size_t maxWorkingSet() const {
+    LatencyBenchmarkRunner &runner =
+      Benchmark::runner<LatencyBenchmarkRunner>();
+    return runner.maxWorkingSet();
+  }
+
+  PagePolicy pagePolicy() const {
+    return Benchmark::runner().pagePolicy();
+  }
+
+  // Loads performed by each run. The whole chain is followed at least once,
+  // so every element of the working set is accessed.
+  size_t loads() const;
+
+public:
+  // Latency measured at each point of a sweep, in nanoseconds per load.
+  class SweepPoint {
+  public:
+    size_t _workingSet;
+    double _best;
+    double _median;
+  };
+
+  typedef std::vector<SweepPoint>::const_iterator sweep_iterator;
+
+  sweep_iterator sweep_begin() const { return _sweep.begin(); }
+  sweep_iterator sweep_end() const { return _sweep.end(); }
+
+protected:
+  // Build the chain of loads, covering the current working set. Return its
+  // length.
+  virtual size_t build() = 0;
+
+  // Perform the given number of dependent loads.
+  virtual void chase(size_t loads) = 0;
+
+private:
+  size_t _chainLength;
+
+  std::vector<SweepPoint> _sweep;
+};
+
+inline std::ostream &hline(std::ostream &os) {
+  for(unsigned i = 0, e = 62; i != e; ++i)
+    os << "-";
+  os << std::endl;
+
+  return os;
+}
+
+} // End namespace florentino.
+
+#endif // BENCHMARKS_H
@@ -0,0 +1,14 @@
+
+#include "loaded-latency.h"
+#include "pointer-chase.h"
+
+using namespace florentino;
+
+int main(int argc, char *argv[]) {
+  LatencyBenchmarkRunner runner(argc, argv);
+
+  runner.add(new PointerChase(runner));
+  runner.add(new LoadedLatency(runner));
+
+  return runner.run();
+}
@@ -0,0 +1,276 @@
+
+#include "loaded-latency.h"
+
+#include "florentino/memory.h"
+#include "florentino/statistics.h"
+
+#include <algorithm>
+#include <iomanip>
+
+#include <sched.h>
+#include <unistd.h>
+
+using namespace florentino;
+
+namespace {
+
+// Traffic threads stream this many elements between two delays: 4KB of each
+// array, a multiple of the cache line size.
+const size_t TRAFFIC_BLOCK_LENGTH = 512;
+
+// Bytes moved by the triad kernel for each element: two loads and a store.
+const size_t TRIAD_BYTES = 3 * sizeof(double);
+
+const double TRIAD_SCALAR = 3.0;
+
+// Traffic arrays together cover at least four times the last level cache, so
+// traffic threads really stream memory.
+const size_t MIN_TRAFFIC_SIZE = size_t(64) << 20;
+
+size_t trafficSize() {
+  long llc = -1;
+
+#ifdef _SC_LEVEL3_CACHE_SIZE
+  llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif // _SC_LEVEL3_CACHE_SIZE
+
+  return std::max(llc > 0 ? 4 * static_cast<size_t>(llc) : 0,
+                  MIN_TRAFFIC_SIZE);
+}
+
+// The first member of the team measures latency. Traffic threads are spread
+// on the other CPUs, if any.
+std::vector<unsigned> teamCPUs(unsigned trafficThreads) {
+  std::vector<unsigned> cpus = ThreadTeam::availableCPUs(),
+                        others(cpus.begin() + 1, cpus.end());
+
+  std::vector<unsigned> team(1, cpus.front()),
+                        traffic = ThreadTeam::spread(others.empty() ? cpus
+                                                                    : others,
+                                                     trafficThreads);
+
+  team.insert(team.end(), traffic.begin(), traffic.end());
+
+  return team;
+}
+
+} // End anonymous namespace.
+
+//
+// LoadedLatency implementation.
+//
+
+LoadedLatency::LoadedLatency(LatencyBenchmarkRunner &runner)
+  : PointerChase("LOADED-LATENCY", runner),
+    _a(0),
+    _b(0),
+    _c(0),
+    _trafficLength(0),
+    _team(0),
+    _kernels(0),
+    _traffic(0),
+    _stop(false),
+    _started(0) {
+  _clocks.reserve(ClkChaseStart, "chase-start");
+  _clocks.reserve(ClkChaseEnd, "chase-end");
+
+  interval("chase", ClkChaseStart, ClkChaseEnd);
+}
+
+LoadedLatency::~LoadedLatency() {
+  if(_team || _a)
+    release();
+}
+
+void LoadedLatency::setup() {
+  LatencyBenchmarkRunner &runner = Benchmark::runner<LatencyBenchmarkRunner>();
+
+  LatencyBench::setup();
+
+  // Traffic arrays and team are kept across the points of a sweep. Pages are
+  // mapped at initialization time, by the thread that is going to use them.
+  if(!_team) {
+    _kernels = &lookupCPUKernels<double>(runner.isa(), false);
+
+    _trafficLength = trafficSize() / TRIAD_BYTES;
+
+    _a = xpalloc<double>(_trafficLength, pagePolicy());
+    _b = xpalloc<double>(_trafficLength, pagePolicy());
+    _c = xpalloc<double>(_trafficLength, pagePolicy());
+
+    _traffic = xaalloc<Traffic>(runner.trafficThreads(), CACHE_LINE_SIZE);
+
+    _team = new ThreadTeam(teamCPUs(runner.trafficThreads()));
+    _team->run(initialize, this);
+  }
+
+  _bytes.clear();
+
+  parameter("traffic-threads", runner.trafficThreads());
+  parameter("traffic-isa", _kernels->_isa);
+  parameter("traffic-size", _trafficLength * TRIAD_BYTES);
+  parameter("delay", delay());
+
+  log() << "Traffic threads = " << runner.trafficThreads()
+        << std::endl
+        << "Traffic kernels ISA = " << _kernels->_isa
+        << std::endl
+        << "Traffic size = " << formatSize(_trafficLength * TRIAD_BYTES)
+        << " bytes"
+        << std::endl
+        << "Injection delay = " << delay()
+        << std::endl
+        << "Threads pinning =";
+
+  for(unsigned i = 0, e = _team->size(); i != e; ++i)
+    log() << " " << i << ":" << _team->cpu(i);
+
+  log() << std::endl
+
+        << hline;
+}
+
+void LoadedLatency::run() {
+  _stop = false;
+  _started = 0;
+
+  _team->run(dispatch, this);
+}
+
+void LoadedLatency::teardown() {
+  const TimeStat &from = _clocks[ClkChaseStart],
+                 &to = _clocks[ClkChaseEnd];
+
+  Statistics stats(to, from, warmup());
+
+  // Bandwidth of each run, warm-up runs excluded.
+  std::vector<double> rates;
+
+  for(size_t i = warmup(), e = std::min(_bytes.size(), to.size()); i < e; ++i)
+    rates.push_back(_bytes[i] * 1e-6 / (to[i] - from[i]));
+
+  Statistics bandwidth(rates);
+
+  CurvePoint point;
+  point._delay = delay();
+  point._bandwidth = bandwidth.empty() ? 0.0 : bandwidth.median();
+  point._best = stats.min() * 1e9 / loads();
+  point._median = stats.median() * 1e9 / loads();
+
+  _curve.push_back(point);
+
+  metric("latency-best-ns", point._best);
+  metric("latency-median-ns", point._median);
+  metric("traffic-MBps", point._bandwidth);
+
+  log() << "Latency = "
+        << std::fixed << std::setprecision(2)
+        << point._median << " ns/load (median), "
+        << point._best << " ns/load (best)"
+        << std::endl
+        << "Traffic = "
+        << std::setprecision(1)
+        << point._bandwidth << " MB/s (median)"
+        << std::endl
+
+        << hline;
+}
+
+void LoadedLatency::release() {
+  delete _team;
+  _team = 0;
+
+  xpfree(_a, _trafficLength, pagePolicy());
+  xpfree(_b, _trafficLength, pagePolicy());
+  xpfree(_c, _trafficLength, pagePolicy());
+  xfree(_traffic);
+
+  _a = _b = _c = 0;
+  _trafficLength = 0;
+  _traffic = 0;
+
+  PointerChase::release();
+}
+
+void LoadedLatency::initialize(void *arg, unsigned id, unsigned count) {
+  LoadedLatency *bench = reinterpret_cast<LoadedLatency *>(arg);
+
+  if(!id)
+    return;
+
+  size_t i, e;
+  bench->chunk(id - 1, count - 1, i, e);
+
+  if(i != e)
+    bench->_kernels->_init(bench->_a, bench->_b, bench->_c, i, e, 0.0);
+
+  bench->_traffic[id - 1]._bytes = 0;
+}
+
+void LoadedLatency::dispatch(void *arg, unsigned id, unsigned count) {
+  LoadedLatency *bench = reinterpret_cast<LoadedLatency *>(arg);
+
+  if(id)
+    bench->stream(id - 1, count - 1);
+  else
+    bench->measure(count - 1);
+}
+
+void LoadedLatency::measure(unsigned trafficThreads) {
+  // Wait for the full load.
+  while(_started != trafficThreads)
+    sched_yield();
+
+  size_t before = trafficBytes();
+
+  _clocks.record(ClkChaseStart);
+  chase(loads());
+  _clocks.record(ClkChaseEnd);
+
+  size_t after = trafficBytes();
+
+  _stop = true;
+
+  _bytes.push_back(after - before);
+}
+
+void LoadedLatency::stream(unsigned id, unsigned trafficThreads) {
+  size_t first, last;
+  chunk(id, trafficThreads, first, last);
+
+  CPUKernels<double>::Kernel triad = _kernels->_triad;
+  volatile size_t &bytes = _traffic[id]._bytes;
+  unsigned wait = delay();
+
+  __sync_fetch_and_add(&_started, 1);
+
+  for(size_t i = first; !_stop && first != last; ) {
+    size_t e = std::min(i + TRAFFIC_BLOCK_LENGTH, last);
+
+    triad(_a, _b, _c, i, e, TRIAD_SCALAR);
+    bytes += (e - i) * TRIAD_BYTES;
+
+    // The empty volatile assembly statement keeps the compiler from removing
+    // the delay loop.
+    for(unsigned j = 0; j != wait; ++j)
+      __asm__ __volatile__("");
+
+    i = e != last ? e : first;
+  }
+}
+
+void LoadedLatency::chunk(unsigned id,
+                          unsigned trafficThreads,
+                          size_t &i,
+                          size_t &e) const {
+  cpuKernelsChunk<double>(_trafficLength, id, trafficThreads, i, e);
+}
+
+size_t LoadedLatency::trafficBytes() const {
+  size_t bytes = 0;
+
+  for(unsigned i = 0, e = _team->size() - 1; i != e; ++i)
+    bytes += _traffic[i]._bytes;
+
+  return bytes;
+}
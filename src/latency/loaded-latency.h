@@ -0,0 +1,104 @@
+
+#ifndef LOADED_LATENCY_H
+#define LOADED_LATENCY_H
+
+#include "pointer-chase.h"
+
+#include "cpu-stream-kernels.h"
+
+#include "florentino/thread.h"
+
+namespace florentino {
+
+// Chase pointers while other threads stream memory with the STREAM triad
+// kernel, as the loaded latency mode of Intel Memory Latency Checker does.
+// Traffic threads wait for a configurable delay between two blocks of streamed
+// memory: sweeping the delay sweeps the load, giving a latency versus bandwidth
+// curve. Latency is measured only while all traffic threads are running.
+class LoadedLatency : public PointerChase {
+public:
+  enum {
+    ClkChaseStart = ClkEnd + 1,
+    ClkChaseEnd
+  };
+
+public:
+  LoadedLatency(LatencyBenchmarkRunner &runner);
+
+  // Release resources if a run threw before release() was called.
+  virtual ~LoadedLatency();
+
+public:
+  virtual void setup();
+  virtual void run();
+  virtual void teardown();
+  virtual void release();
+
+public:
+  virtual bool enabled() const {
+    return runner<LatencyBenchmarkRunner>().loaded();
+  }
+
+  unsigned delay() const {
+    return runner<LatencyBenchmarkRunner>().delay();
+  }
+
+public:
+  // Latency and traffic bandwidth measured at each injection delay.
+  class CurvePoint {
+  public:
+    unsigned _delay;
+    double _bandwidth;
+    double _best;
+    double _median;
+  };
+
+  typedef std::vector<CurvePoint>::const_iterator curve_iterator;
+
+  curve_iterator curve_begin() const { return _curve.begin(); }
+  curve_iterator curve_end() const { return _curve.end(); }
+
+private:
+  static void initialize(void *arg, unsigned id, unsigned count);
+  static void dispatch(void *arg, unsigned id, unsigned count);
+
+  // Chase pointers on the first team member, and stream memory on the others.
+  void measure(unsigned trafficThreads);
+  void stream(unsigned id, unsigned trafficThreads);
+
+  // The range of the traffic arrays streamed by the given traffic thread.
+  void chunk(unsigned id, unsigned trafficThreads, size_t &i, size_t &e) const;
+
+  size_t trafficBytes() const;
+
+private:
+  // Bytes streamed by a traffic thread. Each counter fills a cache line, so
+  // threads do not share lines.
+  class Traffic {
+  public:
+    volatile size_t _bytes;
+    char _padding[64 - sizeof(size_t)];
+  };
+
+private:
+  double *_a;
+  double *_b;
+  double *_c;
+  size_t _trafficLength;
+
+  ThreadTeam *_team;
+  const CPUKernels<double> *_kernels;
+
+  Traffic *_traffic;
+  volatile bool _stop;
+  volatile unsigned _started;
+
+  // Bytes streamed while chasing pointers, for each run.
+  std::vector<double> _bytes;
+
+  std::vector<CurvePoint> _curve;
+};
+
+} // End namespace florentino.
+
+#endif // LOADED_LATENCY_H
@@ -0,0 +1,94 @@
+
+#include "pointer-chase.h"
+
+#include "cpu-stream-kernels.h"
+
+#include "florentino/memory.h"
+#include "florentino/random.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace florentino;
+
+//
+// PointerChase implementation.
+//
+
+PointerChase::~PointerChase() {
+  if(_mem)
+    release();
+}
+
+void PointerChase::release() {
+  xpfree(_mem, _allocSize, pagePolicy());
+
+  _mem = 0;
+  _allocSize = 0;
+  _head = 0;
+}
+
+size_t PointerChase::build() {
+  // Memory is kept across the points of a sweep.
+  if(!_mem) {
+    _allocSize = std::max(maxWorkingSet(), 2 * CACHE_LINE_SIZE);
+    _mem = xpalloc<char>(_allocSize, pagePolicy());
+  }
+
+  size_t lines = std::max<size_t>(workingSet() / CACHE_LINE_SIZE, 2);
+
+  // Sattolo's algorithm: a random permutation made by a single cycle, so the
+  // chain goes through all the lines before coming back.
+  std::vector<size_t> next(lines);
+  Random random;
+
+  for(size_t i = 0; i != lines; ++i)
+    next[i] = i;
+
+  for(size_t i = lines - 1; i != 0; --i)
+    std::swap(next[i], next[random(i)]);
+
+  for(size_t i = 0; i != lines; ++i)
+    *reinterpret_cast<void **>(_mem + i * CACHE_LINE_SIZE) =
+      _mem + next[i] * CACHE_LINE_SIZE;
+
+  _head = reinterpret_cast<void **>(_mem);
+
+  // The chain has been written, so pages are mapped.
+  std::string pages = describePages(_mem);
+
+  parameter("page-policy", pagePolicyName(pagePolicy()));
+  parameter("pages", pages);
+
+  log() << hline
+
+        << "Pages = " << pages
+        << " (" << pagePolicyName(pagePolicy()) << " policy)"
+        << std::endl;
+
+  return lines;
+}
+
+void PointerChase::chase(size_t loads) {
+  void **p = _head;
+  size_t i = 0;
+
+  // Unrolled by hand, to make loop overhead negligible.
+  for(; i + 8 <= loads; i += 8) {
+    p = reinterpret_cast<void **>(*p);
+    p = reinterpret_cast<void **>(*p);
+    p = reinterpret_cast<void **>(*p);
+    p = reinterpret_cast<void **>(*p);
+    p = reinterpret_cast<void **>(*p);
+    p = reinterpret_cast<void **>(*p);
+    p = reinterpret_cast<void **>(*p);
+    p = reinterpret_cast<void **>(*p);
+  }
+
+  for(; i != loads; ++i)
+    p = reinterpret_cast<void **>(*p);
+
+  // Next chase continues from here.
+  _head = p;
+  _sink = p;
+}
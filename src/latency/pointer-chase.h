@@ -0,0 +1,57 @@
+
+#ifndef POINTER_CHASE_H
+#define POINTER_CHASE_H
+
+#include "benchmarks.h"
+
+namespace florentino {
+
+// Chase a chain of pointers through the working set. Each element of the chain
+// fills a cache line, and elements are linked in a random cyclic order, so
+// hardware prefetchers cannot guess the next line to load. Please notice that
+// large working sets also measure TLB misses.
+class PointerChase : public LatencyBench {
+public:
+  PointerChase(LatencyBenchmarkRunner &runner)
+    : LatencyBench("POINTER-CHASE", runner),
+      _mem(0),
+      _allocSize(0),
+      _head(0),
+      _sink(0) { }
+
+protected:
+  PointerChase(const std::string &nm, LatencyBenchmarkRunner &runner)
+    : LatencyBench(nm, runner),
+      _mem(0),
+      _allocSize(0),
+      _head(0),
+      _sink(0) { }
+
+  // Release memory if a run threw before release() was called.
+  virtual ~PointerChase();
+
+public:
+  virtual void release();
+
+public:
+  virtual bool enabled() const {
+    return !runner<LatencyBenchmarkRunner>().loaded();
+  }
+
+protected:
+  virtual size_t build();
+  virtual void chase(size_t loads);
+
+private:
+  char *_mem;
+  size_t _allocSize;
+
+  void **_head;
+
+  // Last loaded pointer: storing it prevents the compiler from removing loads.
+  void *volatile _sink;
+};
+
+} // End namespace florentino.
+
+#endif // POINTER_CHASE_H
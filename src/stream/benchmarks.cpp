@@ -1,18 +1,217 @@
 
 #include "benchmarks.h"
+#include "cpu-stream.h"
+#include "numa-stream.h"
 
+#include "florentino/memory.h"
+#include "florentino/statistics.h"
+#include "florentino/thread.h"
+
+#include <algorithm>
 #include <iomanip>
+#include <limits>
 #include <sstream>
 #include <stdexcept>
+#include <typeinfo>
 
+#include <cctype>
+#include <cstdlib>
 #include <cmath>
 
 using namespace florentino;
 
 namespace {
 
+// Static description of STREAM operations: name, arrays read or written for
+// each array element, and the clocks delimiting the operation.
+class KernelInfo {
+public:
+  const char *_name;
+  size_t _arrays;
+
+  unsigned _from;
+  unsigned _to;
+};
+
+const KernelInfo Kernels[] = {
+  { "Copy", 2, StreamBench::ClkStart, StreamBench::ClkCopy },
+  { "Scale", 2, StreamBench::ClkCopy, StreamBench::ClkScale },
+  { "Add", 3, StreamBench::ClkScale, StreamBench::ClkAdd },
+  { "Triad", 3, StreamBench::ClkAdd, StreamBench::ClkTriad },
+  { "Dot", 2, StreamBench::ClkTriad, StreamBench::ClkDot },
+  { "Fill", 1, StreamBench::ClkDot, StreamBench::ClkEnd }
+};
+
+std::string upper(const std::string &str) {
+  std::string result(str);
+  std::transform(result.begin(), result.end(), result.begin(), ::toupper);
+
+  return result;
+}
+
+// Benchmarks on double are named as in the original benchmark.
+std::string typedName(const std::string &nm, const char *elementType) {
+  if(std::string(elementType) == ElementTraits<double>::name())
+    return nm;
+
+  return nm + "-" + upper(elementType);
+}
+
+bool knownElementType(const std::string &type) {
+  return type == ElementTraits<float>::name() ||
+         type == ElementTraits<double>::name() ||
+         type == ElementTraits<Int32>::name() ||
+         type == ElementTraits<Int64>::name();
+}
+
+// Whether an observed result matches the expected one, within the given
+// relative error. Integer results wrap around in the same way on both sides,
+// so they are checked exactly.
+template <typename Ty>
+bool matches(Ty expected, Ty observed, double tolerance) {
+  if(expected == observed)
+    return true;
+
+  return std::abs(double(expected) - double(observed)) /
+         std::abs(double(observed)) <= tolerance;
+}
+
+// Compensated (Kahan) summation: the rounding error of each addition is kept
+// apart, and fed back into the next one. Integer additions are exact, so for
+// them the compensation is always zero.
+template <typename Ty>
+class KahanSum {
+public:
+  KahanSum() : _sum(0), _error(0) { }
+
+public:
+  void add(Ty value) {
+    Ty y = value - _error,
+       t = _sum + y;
+
+    _error = (t - _sum) - y;
+    _sum = t;
+  }
+
+  Ty value() const { return _sum; }
+
+private:
+  Ty _sum;
+  Ty _error;
+};
+
+// Sums of the arrays checked by validation. Each team member sums a share of
+// the arrays, and stores its partial sums in its own slot.
+template <typename Ty>
+class ArraySums {
+public:
+  typedef typename ElementTraits<Ty>::Accumulator Accumulator;
+
+public:
+  ArraySums(const Ty *a, const Ty *b, const Ty *c,
+            size_t length,
+            unsigned count) : _a(a),
+                              _b(b),
+                              _c(c),
+                              _length(length),
+                              _count(count),
+                              _partials(xaalloc<Partial>(count,
+                                                         CACHE_LINE_SIZE)) { }
+
+  ~ArraySums() {
+    xfree(_partials);
+  }
+
+private:
+  ArraySums(const ArraySums &that); // Do not implement.
+  const ArraySums &operator=(const ArraySums &that); // Do not implement.
+
+public:
+  static void sum(void *arg, unsigned id, unsigned count) {
+    ArraySums *sums = reinterpret_cast<ArraySums *>(arg);
+
+    size_t share = sums->_length / count,
+           extra = sums->_length % count,
+           i = id * share + std::min<size_t>(id, extra),
+           e = i + share + (id < extra ? 1 : 0);
+
+    KahanSum<Accumulator> aSum, bSum, cSum;
+
+    for(; i != e; ++i) {
+      aSum.add(sums->_a[i]);
+      bSum.add(sums->_b[i]);
+      cSum.add(sums->_c[i]);
+    }
+
+    Partial &partial = sums->_partials[id];
+
+    partial._a = aSum.value();
+    partial._b = bSum.value();
+    partial._c = cSum.value();
+  }
+
+public:
+  // Add up the partial sums of all the members.
+  void total(Accumulator &a, Accumulator &b, Accumulator &c) const {
+    KahanSum<Accumulator> aSum, bSum, cSum;
+
+    for(unsigned i = 0; i != _count; ++i) {
+      aSum.add(_partials[i]._a);
+      bSum.add(_partials[i]._b);
+      cSum.add(_partials[i]._c);
+    }
+
+    a = aSum.value();
+    b = bSum.value();
+    c = cSum.value();
+  }
+
+private:
+  // Partials fill a cache line, and they are allocated aligned to a cache
+  // line, so members do not share lines.
+  class Partial {
+  public:
+    Accumulator _a;
+    Accumulator _b;
+    Accumulator _c;
+    char _padding[CACHE_LINE_SIZE - 3 * sizeof(Accumulator)];
+  };
+
+private:
+  const Ty *_a;
+  const Ty *_b;
+  const Ty *_c;
+  size_t _length;
+  unsigned _count;
+
+  Partial *_partials;
+};
+
 void arrayLengthHandler(void *arg, const char *optArg) {
-  unsigned int *arrayLength = reinterpret_cast<unsigned int *>(arg);
+  std::vector<size_t> *arrayLengths =
+    reinterpret_cast<std::vector<size_t> *>(arg);
+
+  std::string value(optArg);
+  size_t length;
+
+  if(value.find(':') != std::string::npos) {
+    if(parseSweep(value, *arrayLengths))
+      return;
+
+  } else if(parseSize(value, length)) {
+    arrayLengths->assign(1, length);
+    return;
+  }
+
+  std::ostringstream os;
+  os << "Error: option '-l' expects a positive length, or a sweep "
+        "FROM:TO:xF or FROM:TO:+S, got '" << optArg << "'";
+
+  throw std::runtime_error(os.str());
+}
+
+void devsCountHandler(void *arg, const char *optArg) {
+  size_t *devsCount = reinterpret_cast<size_t *>(arg);
 
   // Parse to signed type to prevent negative sizes.
   int value;
@@ -22,20 +221,20 @@ void arrayLengthHandler(void *arg, const char *optArg) {
 
   if(is.fail() || !is.eof()) {
     std::ostringstream os;
-    os << "Error: option '-l' expects a positive number, "
+    os << "Error: option '-c' expects a positive number, "
           "got '" << optArg << "'";
 
     throw std::runtime_error(os.str());
   }
 
   if(value < 1)
-    throw std::runtime_error("Error: option '-l' expects a positive number");
+    throw std::runtime_error("Error: option '-c' expects a positive number");
 
-  *arrayLength = value;
+  *devsCount = value;
 }
 
-void devsCountHandler(void *arg, const char *optArg) {
-  unsigned int *devsCount = reinterpret_cast<unsigned int *>(arg);
+void threadsCountHandler(void *arg, const char *optArg) {
+  unsigned int *threadsCount = reinterpret_cast<unsigned int *>(arg);
 
   // Parse to signed type to prevent negative sizes.
   int value;
@@ -45,16 +244,16 @@ void devsCountHandler(void *arg, const char *optArg) {
 
   if(is.fail() || !is.eof()) {
     std::ostringstream os;
-    os << "Error: option '-c' expects a positive number, "
+    os << "Error: option '-j' expects a positive number, "
           "got '" << optArg << "'";
 
     throw std::runtime_error(os.str());
   }
 
   if(value < 1)
-    throw std::runtime_error("Error: option '-c' expects a positive number");
+    throw std::runtime_error("Error: option '-j' expects a positive number");
 
-  *devsCount = value;
+  *threadsCount = value;
 }
 
 void dataDirHandler(void *arg, const char *optArg) {
@@ -65,6 +264,126 @@ void dataDirHandler(void *arg, const char *optArg) {
   *dataDir = optArg;
 }
 
+void cacheDirHandler(void *arg, const char *optArg) {
+  std::string *cacheDir = reinterpret_cast<std::string *>(arg);
+
+  // An empty directory disables caching. The directory is created on demand.
+  *cacheDir = optArg;
+}
+
+// Follow the XDG base directory specification.
+std::string defaultCacheDir() {
+  const char *xdg = std::getenv("XDG_CACHE_HOME");
+  const char *home = std::getenv("HOME");
+
+  if(xdg && *xdg == '/')
+    return std::string(xdg) + "/florentino";
+  else if(home && *home)
+    return std::string(home) + "/.cache/florentino";
+  else
+    return "";
+}
+
+void isaHandler(void *arg, const char *optArg) {
+  std::string *isa = reinterpret_cast<std::string *>(arg);
+
+  // Validation is deferred at the point where kernels are loaded, only there
+  // we know which ISAs are supported.
+  *isa = optArg;
+}
+
+void nonTemporalHandler(void *arg, const char *optArg) {
+  bool *nonTemporal = reinterpret_cast<bool *>(arg);
+
+  *nonTemporal = true;
+}
+
+void autotuneHandler(void *arg, const char *optArg) {
+  bool *autotune = reinterpret_cast<bool *>(arg);
+
+  *autotune = true;
+}
+
+void unrollHandler(void *arg, const char *optArg) {
+  unsigned *unroll = reinterpret_cast<unsigned *>(arg);
+
+  // Zero stands for auto: unroll factors are selected at setup time.
+  if(std::string(optArg) == "auto") {
+    *unroll = 0;
+    return;
+  }
+
+  std::vector<unsigned> unrolls = cpuKernelsUnrolls();
+  unsigned value;
+
+  std::istringstream is(optArg);
+  is >> value;
+
+  if(is.fail() ||
+     !is.eof() ||
+     std::find(unrolls.begin(), unrolls.end(), value) == unrolls.end()) {
+    std::ostringstream os;
+    os << "Error: option '-u' expects auto";
+
+    for(unsigned i = 0, e = unrolls.size(); i != e; ++i)
+      os << (i + 1 != e ? ", " : ", or ") << unrolls[i];
+
+    os << ", got '" << optArg << "'";
+
+    throw std::runtime_error(os.str());
+  }
+
+  *unroll = value;
+}
+
+void elementTypesHandler(void *arg, const char *optArg) {
+  std::vector<std::string> *elementTypes =
+    reinterpret_cast<std::vector<std::string> *>(arg);
+
+  std::istringstream is(optArg);
+  std::vector<std::string> types;
+  std::string type;
+
+  while(std::getline(is, type, ',')) {
+    if(!knownElementType(type)) {
+      std::ostringstream os;
+      os << "Error: option '-e' expects a comma-separated list of float, "
+            "double, int32, int64, got '" << optArg << "'";
+
+      throw std::runtime_error(os.str());
+    }
+
+    if(std::find(types.begin(), types.end(), type) == types.end())
+      types.push_back(type);
+  }
+
+  if(types.empty())
+    throw std::runtime_error("Error: option '-e' expects at least one type");
+
+  elementTypes->swap(types);
+}
+
+#ifdef HAVE_NUMA
+
+std::string nodeName(char kind, int node) {
+  std::ostringstream os;
+  os << kind << node;
+
+  return os.str();
+}
+
+#endif // HAVE_NUMA
+
+void numaHandler(void *arg, const char *optArg) {
+#ifndef HAVE_NUMA
+  throw std::runtime_error("Error: option '-N' needs NUMA support");
+#endif // HAVE_NUMA
+
+  bool *numa = reinterpret_cast<bool *>(arg);
+
+  *numa = true;
+}
+
 } // End anonymous namespace.
 
 //
@@ -75,29 +394,369 @@ const size_t StreamBenchmarkRunner::DEFAULT_ARRAY_LENGTH
   = 24 / sizeof(double) * size_t(1e6);
 const size_t StreamBenchmarkRunner::DEFAULT_DEVS_COUNT
   = 1;
+const unsigned StreamBenchmarkRunner::DEFAULT_THREADS_COUNT
+  = 1;
 const std::string StreamBenchmarkRunner::DEFAULT_DATA_DIR
   = PACKAGE_DATADIR;
+const std::string StreamBenchmarkRunner::DEFAULT_CACHE_DIR
+  = defaultCacheDir();
+const bool StreamBenchmarkRunner::DEFAULT_NUMA
+  = false;
+const std::string StreamBenchmarkRunner::DEFAULT_ISA
+  = "auto";
+const bool StreamBenchmarkRunner::DEFAULT_NON_TEMPORAL
+  = false;
+const unsigned StreamBenchmarkRunner::DEFAULT_UNROLL
+  = 0;
+const bool StreamBenchmarkRunner::DEFAULT_AUTOTUNE
+  = false;
+const std::string StreamBenchmarkRunner::DEFAULT_ELEMENT_TYPES
+  = ElementTraits<double>::name();
 
 StreamBenchmarkRunner::StreamBenchmarkRunner(int argc, char *argv[])
   : BenchmarkRunner(argc, argv),
+    _arrayLengths(1, DEFAULT_ARRAY_LENGTH),
     _arrayLength(DEFAULT_ARRAY_LENGTH),
     _devsCount(DEFAULT_DEVS_COUNT),
-    _dataDir(DEFAULT_DATA_DIR) {
+    _threadsCount(DEFAULT_THREADS_COUNT),
+    _dataDir(DEFAULT_DATA_DIR),
+    _cacheDir(DEFAULT_CACHE_DIR),
+    _numa(DEFAULT_NUMA),
+    _isa(DEFAULT_ISA),
+    _nonTemporal(DEFAULT_NON_TEMPORAL),
+    _unroll(DEFAULT_UNROLL),
+    _autotune(DEFAULT_AUTOTUNE),
+    _elementTypes(1, DEFAULT_ELEMENT_TYPES) {
   add(Option('l', Option::REQUIRED_ARGUMENT,
-             arrayLengthHandler, &_arrayLength,
-             "-l L", "set array length to L"));
+             arrayLengthHandler, &_arrayLengths,
+             "-l L", "set array length to L (e.g. 64G), or sweep FROM:TO:xF"));
   add(Option('c', Option::REQUIRED_ARGUMENT,
              devsCountHandler, &_devsCount,
              "-c C", "use C OpenCL devices"));
+  add(Option('j', Option::REQUIRED_ARGUMENT,
+             threadsCountHandler, &_threadsCount,
+             "-j J", "use J threads for CPU benchmarks"));
   add(Option('d', Option::REQUIRED_ARGUMENT,
              dataDirHandler, &_dataDir,
              "-d D", "set data directory to D"));
+  add(Option('C', Option::REQUIRED_ARGUMENT,
+             cacheDirHandler, &_cacheDir,
+             "-C D", "cache compiled OpenCL programs in D ('' disables)"));
+  add(Option('N', Option::NO_ARGUMENT,
+             numaHandler, &_numa,
+             "-N", "measure bandwidth between all NUMA nodes"));
+  add(Option('i', Option::REQUIRED_ARGUMENT,
+             isaHandler, &_isa,
+             "-i I", "use I (avx512, avx2, sse2, scalar) CPU kernels"));
+  add(Option('t', Option::NO_ARGUMENT,
+             nonTemporalHandler, &_nonTemporal,
+             "-t", "also run CPU kernels with non-temporal stores"));
+  add(Option('u', Option::REQUIRED_ARGUMENT,
+             unrollHandler, &_unroll,
+             "-u U", "unroll CPU kernels U (auto, 1, 2, 4, 8) times"));
+  add(Option('T', Option::NO_ARGUMENT,
+             autotuneHandler, &_autotune,
+             "-T", "autotune OpenCL GPU kernels, reusing saved results"));
+  add(Option('e', Option::REQUIRED_ARGUMENT,
+             elementTypesHandler, &_elementTypes,
+             "-e E", "run on E (float, double, int32, int64) elements"));
+}
+
+std::string StreamBenchmarkRunner::selectPoint(unsigned i) {
+  _arrayLength = _arrayLengths[i];
+
+  if(!sweep())
+    return "";
+
+  std::ostringstream os;
+  os << _arrayLength;
+
+  return os.str();
+}
+
+void StreamBenchmarkRunner::summarize() {
+  // Each summary is closed by a rule, so only the first one must be opened:
+  // benchmark reports do not end with a rule.
+  if(sweep() || elementTypesCount() > 1 || nonTemporal() || numa())
+    log() << hline;
+
+  if(sweep())
+    summarizeSweep();
+
+  if(elementTypesCount() > 1)
+    summarizeTypes();
+
+  if(nonTemporal()) {
+    summarizeStores<float>();
+    summarizeStores<double>();
+    summarizeStores<Int32>();
+    summarizeStores<Int64>();
+  }
+
+  if(numa()) {
+    summarizeNUMA<float>();
+    summarizeNUMA<double>();
+    summarizeNUMA<Int32>();
+    summarizeNUMA<Int64>();
+  }
+}
+
+void StreamBenchmarkRunner::summarizeSweep() {
+  for(iterator i = begin(), e = end(); i != e; ++i) {
+    StreamBench *bench = dynamic_cast<StreamBench *>(*i);
+
+    if(!bench || bench->sweep_begin() == bench->sweep_end())
+      continue;
+
+    // The benchmark is now named after the last point.
+    std::string name = bench->name();
+    name.erase(name.rfind('@'));
+
+    log() << name << " best rates (MB/s) by array length:"
+          << std::endl
+
+          << std::setw(12) << "length"
+          << std::setw(12) << "working-set";
+
+    for(unsigned k = 0, f = StreamBench::KernelsCount; k != f; ++k)
+      log() << std::setw(12)
+            << StreamBench::kernelName(StreamBench::Kernel(k));
+
+    log() << std::endl;
+
+    for(StreamBench::sweep_iterator j = bench->sweep_begin(),
+                                    g = bench->sweep_end();
+                                    j != g;
+                                    ++j) {
+      // All the three arrays are touched by a STREAM run.
+      log() << std::setw(12) << j->_length
+            << std::setw(12)
+            << formatSize(3 * bench->elementBytes() * j->_length);
+
+      for(unsigned k = 0, f = StreamBench::KernelsCount; k != f; ++k)
+        log() << std::fixed << std::setprecision(1) << std::setw(12)
+              << j->_bestRates[k];
+
+      log() << std::endl;
+    }
+
+    log() << hline;
+  }
+}
+
+void StreamBenchmarkRunner::summarizeTypes() {
+  std::vector<StreamBench *> benches;
+
+  benches.push_back(cpuStream<float>(false));
+  benches.push_back(cpuStream<double>(false));
+  benches.push_back(cpuStream<Int32>(false));
+  benches.push_back(cpuStream<Int64>(false));
+
+  benches.erase(std::remove(benches.begin(), benches.end(),
+                            static_cast<StreamBench *>(0)),
+                benches.end());
+
+  if(benches.size() < 2)
+    return;
+
+  // Bandwidth first, then the rate at which elements are processed.
+  for(unsigned u = 0; u != 2; ++u) {
+    log() << "CPU best rates (" << (u ? "Melem/s" : "MB/s") << ") "
+          << "by element type:"
+          << std::endl
+
+          << std::setw(8) << "";
+
+    for(unsigned k = 0, f = StreamBench::KernelsCount; k != f; ++k)
+      log() << std::setw(12)
+            << StreamBench::kernelName(StreamBench::Kernel(k));
+
+    log() << std::endl;
+
+    for(unsigned i = 0, e = benches.size(); i != e; ++i) {
+      StreamBench *bench = benches[i];
+
+      log() << std::left << std::setw(8)
+            << (std::string(bench->elementType()) + ":")
+            << std::right;
+
+      for(unsigned k = 0, f = StreamBench::KernelsCount; k != f; ++k) {
+        StreamBench::Kernel kernel = StreamBench::Kernel(k);
+
+        log() << std::fixed << std::setprecision(1) << std::setw(12)
+              << (u ? bench->bestElementRate(kernel)
+                    : bench->bestRate(kernel));
+      }
+
+      log() << std::endl;
+    }
+
+    log() << hline;
+  }
+}
+
+template <typename Ty>
+void StreamBenchmarkRunner::summarizeStores() {
+  StreamBench *regular = cpuStream<Ty>(false),
+              *nonTemporal = cpuStream<Ty>(true);
+
+  if(!regular || !nonTemporal)
+    return;
+
+  log() << "CPU best rates (MB/s) on " << ElementTraits<Ty>::name()
+        << " elements by kind of stores:"
+        << std::endl
+
+        << std::setw(12) << ""
+        << std::setw(14) << "regular"
+        << std::setw(14) << "non-temporal"
+        << std::endl;
+
+  for(unsigned i = 0, e = StreamBench::KernelsCount; i != e; ++i) {
+    StreamBench::Kernel kernel = StreamBench::Kernel(i);
+
+    log() << std::left << std::setw(12)
+          << (std::string(StreamBench::kernelName(kernel)) + ":")
+          << std::right
+          << std::fixed << std::setprecision(1)
+          << std::setw(14) << regular->bestRate(kernel)
+          << std::setw(14) << nonTemporal->bestRate(kernel)
+          << std::endl;
+  }
+
+  log() << hline;
+}
+
+template <typename Ty>
+void StreamBenchmarkRunner::summarizeNUMA() {
+#ifdef HAVE_NUMA
+  std::vector<int> memNodes = NUMANodes::memoryNodes(),
+                   cpuNodes = NUMANodes::cpuNodes();
+
+  // Rows are indexed by memory node, columns by CPU node.
+  typedef std::vector<std::vector<double> > Matrix;
+  std::vector<Matrix> rates(StreamBench::KernelsCount,
+                            Matrix(memNodes.size(),
+                                   std::vector<double>(cpuNodes.size())));
+
+  bool found = false;
+
+  for(iterator i = begin(), e = end(); i != e; ++i) {
+    NUMACPUStream<Ty> *bench = dynamic_cast<NUMACPUStream<Ty> *>(*i);
+
+    if(!bench || !bench->enabled())
+      continue;
+
+    std::vector<int>::iterator m = std::find(memNodes.begin(),
+                                             memNodes.end(),
+                                             bench->memoryNode()),
+                               c = std::find(cpuNodes.begin(),
+                                             cpuNodes.end(),
+                                             bench->cpuNode());
+
+    for(unsigned k = 0, f = StreamBench::KernelsCount; k != f; ++k)
+      rates[k][m - memNodes.begin()][c - cpuNodes.begin()] =
+        bench->bestRate(StreamBench::Kernel(k));
+
+    found = true;
+  }
+
+  if(!found)
+    return;
+
+  log() << "NUMA best rates (MB/s) on " << ElementTraits<Ty>::name()
+        << " elements, memory nodes by CPU nodes:"
+        << std::endl;
+
+  for(unsigned k = 0, f = StreamBench::KernelsCount; k != f; ++k) {
+    log() << std::left << std::setw(8)
+          << (std::string(StreamBench::kernelName(StreamBench::Kernel(k))) +
+              ":")
+          << std::right;
+
+    for(unsigned j = 0, g = cpuNodes.size(); j != g; ++j)
+      log() << std::setw(12) << nodeName('C', cpuNodes[j]);
+
+    log() << std::endl;
+
+    for(unsigned i = 0, e = memNodes.size(); i != e; ++i) {
+      log() << std::setw(8) << nodeName('M', memNodes[i]);
+
+      for(unsigned j = 0, g = cpuNodes.size(); j != g; ++j)
+        log() << std::fixed << std::setprecision(1) << std::setw(12)
+              << rates[k][i][j];
+
+      log() << std::endl;
+    }
+  }
+
+  log() << hline;
+#endif // HAVE_NUMA
+}
+
+template <typename Ty>
+StreamBench *StreamBenchmarkRunner::cpuStream(bool nonTemporal) const {
+  for(iterator i = begin(), e = end(); i != e; ++i) {
+    // Subclasses -- e.g. NUMA benchmarks -- have their own summary.
+    if(typeid(**i) != typeid(CPUStream<Ty>))
+      continue;
+
+    CPUStream<Ty> *bench = static_cast<CPUStream<Ty> *>(*i);
+
+    if(bench->enabled() && bench->nonTemporal() == nonTemporal)
+      return bench;
+  }
+
+  return 0;
 }
 
 //
 // StreamBench implementation.
 //
 
+StreamBench::StreamBench(const std::string &nm,
+                         StreamBenchmarkRunner &runner,
+                         const char *elementType,
+                         size_t elementBytes)
+  : Benchmark(typedName(nm, elementType), runner),
+    _elementType(elementType),
+    _elementBytes(elementBytes) {
+  _clocks.reserve(ClkCopy, "copy");
+  _clocks.reserve(ClkScale, "scale");
+  _clocks.reserve(ClkAdd, "add");
+  _clocks.reserve(ClkTriad, "triad");
+  _clocks.reserve(ClkDot, "dot");
+
+  for(unsigned i = 0, e = KernelsCount; i != e; ++i) {
+    const KernelInfo &info = Kernels[i];
+
+    interval(kernelTag(Kernel(i)), info._from, info._to);
+
+    _bestRates[i] = 0.0;
+  }
+}
+
+Statistics StreamBench::kernelStatistics(Kernel kernel) const {
+  const KernelInfo &info = Kernels[kernel];
+
+  return Statistics(_clocks[info._to], _clocks[info._from], warmup());
+}
+
+const char *StreamBench::kernelName(Kernel kernel) {
+  return Kernels[kernel]._name;
+}
+
+std::string StreamBench::kernelTag(Kernel kernel) {
+  std::string tag(Kernels[kernel]._name);
+  std::transform(tag.begin(), tag.end(), tag.begin(), ::tolower);
+
+  return tag;
+}
+
+size_t StreamBench::kernelBytes(Kernel kernel) const {
+  return Kernels[kernel]._arrays * _elementBytes;
+}
+
 void StreamBench::setup() {
   log() << hline
 
@@ -107,22 +766,29 @@ void StreamBench::setup() {
         << hline
 
         << "This system uses "
-        << sizeof(double)
-        << " bytes per DOUBLE PRECISION word."
+        << _elementBytes
+        << " bytes per " << upper(_elementType) << " word."
         << std::endl
 
         << hline
 
         << "Array size = " << arrayLength()
         << std::endl
+        << "Passes per run = " << passes()
+        << std::endl
         << "Total memory required = "
         << std::scientific << std::setprecision(1)
-        << (3 * sizeof(double) * arrayLength() * 1e-6)
+        << (3 * _elementBytes * arrayLength() * 1e-6)
         << " MB."
         << std::endl
 
         << hline;
 
+  parameter("array-length", arrayLength());
+  parameter("element-type", _elementType);
+  parameter("element-bytes", _elementBytes);
+  parameter("passes", passes());
+
   // Initialize arrays.
   init();
 
@@ -131,34 +797,108 @@ void StreamBench::setup() {
   scale(3.0);
   add();
   triad(3.0);
+  dot();
+  fill(3.0);
 
   // Re-initialize.
   init();
 }
 
 void StreamBench::run() {
-  copy();
-  scale(3.0);
-  add();
-  triad(3.0);
+  unsigned n = passes();
+
+  for(unsigned i = 0; i != n; ++i)
+    copy();
+  _clocks.record(ClkCopy);
+
+  for(unsigned i = 0; i != n; ++i)
+    scale(3.0);
+  _clocks.record(ClkScale);
+
+  for(unsigned i = 0; i != n; ++i)
+    add();
+  _clocks.record(ClkAdd);
+
+  for(unsigned i = 0; i != n; ++i)
+    triad(3.0);
+  _clocks.record(ClkTriad);
+
+  for(unsigned i = 0; i != n; ++i)
+    dot();
+  _clocks.record(ClkDot);
+
+  for(unsigned i = 0; i != n; ++i)
+    fill(3.0);
+}
+
+void StreamBench::runKernel(Kernel kernel) {
+  switch(kernel) {
+  case Copy:
+    copy();
+    break;
+  case Scale:
+    scale(3.0);
+    break;
+  case Add:
+    add();
+    break;
+  case Triad:
+    triad(3.0);
+    break;
+  case Dot:
+    dot();
+    break;
+  case Fill:
+    fill(3.0);
+    break;
+  default:
+    break;
+  }
 }
 
 void StreamBench::teardown() {
-  size_t memOpsPerIter = 2 + // copy: reads c[i] -- writes a[i]
-                         2 + // scale: reads c[i] -- writes b[i]
-                         3 + // add: reads a[i], b[i] -- writes c[i]
-                         3;  // triad: reads b[i], c[i] -- writes a[i]
+  log() << "Function    Best Rate MB/s  Avg time     Min time     Max time"
+        << "     Best Melem/s"
+        << std::endl;
+
+  SweepPoint point;
+  point._length = arrayLength();
+
+  for(unsigned i = 0, e = KernelsCount; i != e; ++i) {
+    const KernelInfo &info = Kernels[i];
+
+    // Warm-up runs are not considered.
+    Statistics stats = kernelStatistics(Kernel(i));
+    size_t totalSize = kernelBytes(Kernel(i)) * arrayLength() * passes();
+
+    _bestRates[i] = totalSize * 1e-6 / stats.min();
+    point._bestRates[i] = _bestRates[i];
+
+    std::string name = kernelTag(Kernel(i));
+
+    metric(name + "-best-rate-MBps", _bestRates[i]);
+    metric(name + "-avg-rate-MBps", totalSize * 1e-6 / stats.mean());
+    metric(name + "-best-rate-Melemps", bestElementRate(Kernel(i)));
+
+    log() << std::left << std::setw(12) << (std::string(info._name) + ":")
+          << std::right
+          << std::fixed << std::setprecision(1) << std::setw(14)
+          << _bestRates[i]
+          << std::fixed << std::setprecision(6)
+          << "  " << std::setw(11) << stats.mean()
+          << "  " << std::setw(11) << stats.min()
+          << "  " << std::setw(11) << stats.max()
+          << std::fixed << std::setprecision(1)
+          << "  " << std::setw(12) << bestElementRate(Kernel(i))
+          << std::endl;
+  }
+
+  _sweep.push_back(point);
 
   double totalTime = _clocks[ClkEnd][runs() - 1] -
                      _clocks[ClkStart][0];
-  size_t totalSize = memOpsPerIter * sizeof(double) * arrayLength() * runs();
 
-  log() << "Average rate (MB/s): "
-        << std::scientific << std::setprecision(4) << std::setw(11)
-        << (totalSize * 1e-6 / totalTime)
-        << std::endl
-
-        << "TOTAL time (without initialization) = "
+  log() << "TOTAL time (without initialization) = "
         << std::scientific << std::setprecision(4) << std::setw(11)
         << totalTime
         << " seconds"
@@ -171,17 +911,23 @@ void StreamBench::teardown() {
    log() << hline;
 }
 
-void StreamBench::check(const double *a,
-                        const double *b,
-                        const double *c,
-                        double k) {
-  double ai, bi, ci;
+template <typename Ty>
+void StreamBench::check(const Ty *a,
+                        const Ty *b,
+                        const Ty *c,
+                        Ty k,
+                        typename ElementTraits<Ty>::Accumulator dot,
+                        ThreadTeam &team) {
+  typedef typename ElementTraits<Ty>::Accumulator Accumulator;
+
+  Ty ai, bi, ci, di;
 
   // Reproduce initialization.
-  ai = 1.0;
-  bi = 2.0;
-  ci = 0.0;
-  ai *= 2.0;
+  ai = 1;
+  bi = 2;
+  ci = 0;
+  ai *= 2;
+  di = 0;
 
   // Simulate timed loop.
   for(unsigned i = 0, e = runs(); i != e; ++i) {
@@ -189,44 +935,84 @@ void StreamBench::check(const double *a,
     bi = k * ci;
     ci = ai + bi;
     ai = bi + k * ci;
+    di = ai * bi;
+    ci = k;
   }
-  ai *= arrayLength();
-  bi *= arrayLength();
-  ci *= arrayLength();
 
-  double aSum = 0.0,
-         bSum = 0.0,
-         cSum = 0.0;
+  // All the elements of an array are equal.
+  Accumulator length = arrayLength(),
+              aExp = length * ai,
+              bExp = length * bi,
+              cExp = length * ci,
+              dotExp = length * di;
 
-  for(unsigned i = 0, e = arrayLength(); i != e; ++i) {
-    aSum += a[i];
-    bSum += b[i];
-    cSum += c[i];
-  }
+  ArraySums<Ty> sums(a, b, c, arrayLength(), team.size());
+  team.run(ArraySums<Ty>::sum, &sums);
+
+  Accumulator aSum, bSum, cSum;
+  sums.total(aSum, bSum, cSum);
 
   log() << "Result comparison:"
         << std::endl
 
         << "       expected  : "
-        << std::scientific << ai << " "
-        << std::scientific << bi << " "
-        << std::scientific << ci << " "
+        << std::scientific << aExp << " "
+        << std::scientific << bExp << " "
+        << std::scientific << cExp << " "
+        << std::scientific << dotExp << " "
         << std::endl
 
         << "       observed  : "
         << std::scientific << aSum << " "
         << std::scientific << bSum << " "
         << std::scientific << cSum << " "
+        << std::scientific << dot << " "
         << std::endl;
 
-  if(std::abs(ai - aSum) / aSum > 1e-8)
+  // Floating point values overflow after many runs, and then compare equal.
+  if(!(std::abs(double(aExp)) <= std::numeric_limits<double>::max()))
+    log() << "Warning: values overflowed, validation is not meaningful"
+          << std::endl;
+
+  double tolerance = ElementTraits<Ty>::tolerance();
+
+  if(!matches(aExp, aSum, tolerance))
     throw std::runtime_error("Failed validation on array a[]");
 
-  if(std::abs(bi - bSum) / bSum > 1e-8)
+  if(!matches(bExp, bSum, tolerance))
     throw std::runtime_error("Failed validation on array b[]");
 
-  if(std::abs(ci - cSum) / cSum > 1e-8)
+  if(!matches(cExp, cSum, tolerance))
     throw std::runtime_error("Failed validation on array c[]");
 
+  if(!matches(dotExp, dot, tolerance))
+    throw std::runtime_error("Failed validation on dot product");
+
   log() << "Solution validates" << std::endl;
 }
+
+// Validation is used by benchmarks on all the supported element types.
+template void StreamBench::check(const float *a,
+                                 const float *b,
+                                 const float *c,
+                                 float k,
+                                 double dot,
+                                 ThreadTeam &team);
+template void StreamBench::check(const double *a,
+                                 const double *b,
+                                 const double *c,
+                                 double k,
+                                 double dot,
+                                 ThreadTeam &team);
+template void StreamBench::check(const Int32 *a,
+                                 const Int32 *b,
+                                 const Int32 *c,
+                                 Int32 k,
+                                 Int32 dot,
+                                 ThreadTeam &team);
+template void StreamBench::check(const Int64 *a,
+                                 const Int64 *b,
+                                 const Int64 *c,
+                                 Int64 k,
+                                 Int64 dot,
+                                 ThreadTeam &team);
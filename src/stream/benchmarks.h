@@ -4,17 +4,32 @@
 
 #include "florentino/benchmark-runner.h"
 
+#include "element-types.h"
+
+#include <algorithm>
+
 // Port of John McCalpin's STREAM benchmark. The original benchmark employs
 // statically sized arrays and target CPU. The benchmark has been extended such
 // as the size of the array is configurable from command line. This can prevent
 // aggressive compiler optimization, so I applied some optimization by hand.
 namespace florentino {
 
+class StreamBench;
+class ThreadTeam;
+
 class StreamBenchmarkRunner : public BenchmarkRunner {
 public:
   static const size_t DEFAULT_ARRAY_LENGTH;
   static const size_t DEFAULT_DEVS_COUNT;
+  static const unsigned DEFAULT_THREADS_COUNT;
+  static const bool DEFAULT_NUMA;
+  static const std::string DEFAULT_ISA;
+  static const bool DEFAULT_NON_TEMPORAL;
+  static const unsigned DEFAULT_UNROLL;
+  static const bool DEFAULT_AUTOTUNE;
+  static const std::string DEFAULT_ELEMENT_TYPES;
   static const std::string DEFAULT_DATA_DIR;
+  static const std::string DEFAULT_CACHE_DIR;
 
 public:
   StreamBenchmarkRunner(int argc, char *argv[]);
@@ -22,22 +37,103 @@ public:
 public:
   // Size of the array used by STREAM to measure memory bandwidth. Please notice
   // that should be at least twice the size of the LLC in order to avoid caching
-  // effects.
+  // effects -- unless a sweep is requested, in order to measure bandwidth of
+  // every level of the memory hierarchy. In that case, this is the length used
+  // by the current point of the sweep.
   size_t arrayLength() const { return _arrayLength; }
 
+  // The largest length of the sweep. Benchmarks allocate arrays this long
+  // once, and reuse them at every point.
+  size_t maxArrayLength() const {
+    return *std::max_element(_arrayLengths.begin(), _arrayLengths.end());
+  }
+
+  bool sweep() const { return _arrayLengths.size() > 1; }
+
   // Some version of this benchmark -- e.g. OpenCL -- can exploit multiple
   // devices. This is a command line configurable parameter.
   size_t devsCount() const { return _devsCount; }
 
+  // The CPU version of this benchmark can split arrays among multiple threads,
+  // each of them pinned to a different CPU.
+  unsigned threadsCount() const { return _threadsCount; }
+
   // Some version of this benchmark -- e.g. OpenCL -- requires to load data from
   // files in order to run. This parameter identify the directory where look for
   // these files.
   const std::string &dataDir() const { return _dataDir; }
 
+  // Compiled OpenCL programs are cached in this directory, so that later runs
+  // skip building them from source. Caching is disabled when empty.
+  const std::string &cacheDir() const { return _cacheDir; }
+
+  // When set, the CPU version of this benchmark is run for every pair of NUMA
+  // nodes, placing arrays on the first node and threads on the second one.
+  bool numa() const { return _numa; }
+
+  // The instruction set used by the CPU version of this benchmark. By default,
+  // the most advanced one supported by the running CPU is selected.
+  const std::string &isa() const { return _isa; }
+
+  // When set, the CPU version of this benchmark is run also with non-temporal
+  // stores, in order to measure bandwidth without write-allocate traffic.
+  bool nonTemporal() const { return _nonTemporal; }
+
+  // How many vectors are processed by each iteration of the main loop of the
+  // CPU kernels. By default -- zero -- every unroll factor is timed at setup,
+  // and the fastest one is picked for each kernel.
+  unsigned unroll() const { return _unroll; }
+
+  // When set, the OpenCL GPU version of this benchmark searches the fastest
+  // vector width and iteration space of each kernel on each device. Results are
+  // saved in the cache directory, and reused by later runs.
+  bool autotune() const { return _autotune; }
+
+  // Benchmarks are run on arrays of each of the requested element types --
+  // e.g. float, int32. By default, only double is used, as in the original
+  // benchmark.
+  bool elementType(const std::string &type) const {
+    return std::find(_elementTypes.begin(),
+                     _elementTypes.end(),
+                     type) != _elementTypes.end();
+  }
+
+  size_t elementTypesCount() const { return _elementTypes.size(); }
+
+protected:
+  virtual unsigned pointsCount() const { return _arrayLengths.size(); }
+  virtual std::string selectPoint(unsigned i);
+
+  virtual void summarize();
+
 private:
+  void summarizeSweep();
+  void summarizeTypes();
+
+  template <typename Ty>
+  void summarizeStores();
+
+  template <typename Ty>
+  void summarizeNUMA();
+
+  // The CPU benchmark on Ty elements using the given kind of stores, or null if
+  // it is not run. NUMA benchmarks are not considered.
+  template <typename Ty>
+  StreamBench *cpuStream(bool nonTemporal) const;
+
+private:
+  std::vector<size_t> _arrayLengths;
   size_t _arrayLength;
   size_t _devsCount;
+  unsigned _threadsCount;
   std::string _dataDir;
+  std::string _cacheDir;
+  bool _numa;
+  std::string _isa;
+  bool _nonTemporal;
+  unsigned _unroll;
+  bool _autotune;
+  std::vector<std::string> _elementTypes;
 };
 
 // The structure of STREAM is very simple: the following member-wise operations
@@ -48,14 +144,48 @@ private:
 // - add
 // - triad
 //
-// Subclasses must implement them. This class just implement logging and it
-// drives benchmark execution. Please notice you have to implement the init
-// member function in order to fill arrays with initial values. That operation
-// is not timed.
+// All of them both read and write memory. Two more operations measure one
+// direction only:
+//
+// - dot: a reduction, only reading memory
+// - fill: a constant is stored, only writing memory
+//
+// Subclasses must implement them, on arrays of a given element type. This
+// class just implement logging and it drives benchmark execution. Please notice
+// you have to implement the init member function in order to fill arrays with
+// initial values. That operation is not timed.
+//
+// Each operation is timed on its own, so subclasses must not return from an
+// operation until it has been completed.
 class StreamBench : public Benchmark {
+public:
+  // The timed STREAM operations.
+  enum Kernel {
+    Copy,
+    Scale,
+    Add,
+    Triad,
+    Dot,
+    Fill,
+    KernelsCount
+  };
+
+  // Clocks recording when an operation ends. Copy starts at ClkStart, while
+  // fill ends at ClkEnd.
+  enum {
+    ClkCopy = ClkEnd + 1,
+    ClkScale,
+    ClkAdd,
+    ClkTriad,
+    ClkDot
+  };
+
 protected:
-  StreamBench(const std::string &nm, StreamBenchmarkRunner &runner)
-    : Benchmark(nm, runner) { }
+  // Benchmarks on elements other than double are named after the type.
+  StreamBench(const std::string &nm,
+              StreamBenchmarkRunner &runner,
+              const char *elementType,
+              size_t elementBytes);
 
 public:
   virtual void setup();
@@ -63,33 +193,150 @@ public:
   virtual void teardown();
 
 public:
+  virtual bool enabled() const {
+    StreamBenchmarkRunner &runner = Benchmark::runner<StreamBenchmarkRunner>();
+    return runner.elementType(_elementType);
+  }
+
+  const char *elementType() const { return _elementType; }
+  size_t elementBytes() const { return _elementBytes; }
+
   size_t arrayLength() const {
     StreamBenchmarkRunner &runner = Benchmark::runner<StreamBenchmarkRunner>();
     return runner.arrayLength();
   }
 
+  size_t maxArrayLength() const {
+    StreamBenchmarkRunner &runner = Benchmark::runner<StreamBenchmarkRunner>();
+    return runner.maxArrayLength();
+  }
+
   size_t devsCount() const {
     StreamBenchmarkRunner &runner = Benchmark::runner<StreamBenchmarkRunner>();
     return runner.devsCount();
   }
 
+  unsigned threadsCount() const {
+    StreamBenchmarkRunner &runner = Benchmark::runner<StreamBenchmarkRunner>();
+    return runner.threadsCount();
+  }
+
   const std::string &dataDir() const {
     StreamBenchmarkRunner &runner = Benchmark::runner<StreamBenchmarkRunner>();
     return runner.dataDir();
   }
 
+  const std::string &cacheDir() const {
+    StreamBenchmarkRunner &runner = Benchmark::runner<StreamBenchmarkRunner>();
+    return runner.cacheDir();
+  }
+
+  const std::string &isa() const {
+    StreamBenchmarkRunner &runner = Benchmark::runner<StreamBenchmarkRunner>();
+    return runner.isa();
+  }
+
+  unsigned unroll() const {
+    StreamBenchmarkRunner &runner = Benchmark::runner<StreamBenchmarkRunner>();
+    return runner.unroll();
+  }
+
+  bool autotune() const {
+    StreamBenchmarkRunner &runner = Benchmark::runner<StreamBenchmarkRunner>();
+    return runner.autotune();
+  }
+
+  PagePolicy pagePolicy() const {
+    return Benchmark::runner().pagePolicy();
+  }
+
+  // When sweeping, short arrays are streamed many times by each run, so that
+  // timed regions are long enough to be measured accurately: each run streams
+  // at least as many elements as with the default array length. A single array
+  // length is always streamed once per run, as the original benchmark does.
+  unsigned passes() const {
+    StreamBenchmarkRunner &runner = Benchmark::runner<StreamBenchmarkRunner>();
+
+    if(!runner.sweep())
+      return 1;
+
+    size_t length = arrayLength(),
+           defaultLength = StreamBenchmarkRunner::DEFAULT_ARRAY_LENGTH;
+
+    return (defaultLength + length - 1) / length;
+  }
+
+  // Statistics about the time spent by each run in the given operation, warm-up
+  // runs excluded.
+  Statistics kernelStatistics(Kernel kernel) const;
+
+  // Best memory bandwidth measured by the given operation, in MB/s.
+  double bestRate(Kernel kernel) const {
+    return _bestRates[kernel];
+  }
+
+  // Best rate of the given operation, in millions of elements per second.
+  double bestElementRate(Kernel kernel) const {
+    return _bestRates[kernel] / kernelBytes(kernel);
+  }
+
+  // Best rates measured at each point of a sweep, by increasing length.
+  class SweepPoint {
+  public:
+    size_t _length;
+    double _bestRates[KernelsCount];
+  };
+
+  typedef std::vector<SweepPoint>::const_iterator sweep_iterator;
+
+  sweep_iterator sweep_begin() const { return _sweep.begin(); }
+  sweep_iterator sweep_end() const { return _sweep.end(); }
+
+public:
+  static const char *kernelName(Kernel kernel);
+
+  // Lower case name of an operation, used to name intervals, parameters, and
+  // metrics.
+  static std::string kernelTag(Kernel kernel);
+
+  // Bytes read and written by an operation for each array element.
+  size_t kernelBytes(Kernel kernel) const;
+
 protected:
   virtual void init() = 0;
   virtual void copy() = 0;
   virtual void scale(double k) = 0;
   virtual void add() = 0;
   virtual void triad(double k) = 0;
+  // The result of the dot product must be kept, for validation.
+  virtual void dot() = 0;
+  virtual void fill(double k) = 0;
 
   virtual void check(double k) = 0;
 
 protected:
-  // Utility method that perform benchmark validation on the host.
-  void check(const double *a, const double *b, const double *c, double k);
+  // Run the given operation once, with the same arguments used by run. Useful
+  // to time operations outside of the benchmark runs.
+  void runKernel(Kernel kernel);
+
+protected:
+  // Utility method that perform benchmark validation on the host, given the
+  // arrays and the result of the last dot product. Arrays are summed in
+  // parallel by the members of team, with compensated summation, so that long
+  // arrays are validated quickly and without losing precision.
+  template <typename Ty>
+  void check(const Ty *a, const Ty *b, const Ty *c,
+             Ty k,
+             typename ElementTraits<Ty>::Accumulator dot,
+             ThreadTeam &team);
+
+private:
+  const char *_elementType;
+  size_t _elementBytes;
+
+  double _bestRates[KernelsCount];
+
+  std::vector<SweepPoint> _sweep;
 };
 
 inline std::ostream &hline(std::ostream &os) {
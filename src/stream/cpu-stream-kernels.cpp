@@ -0,0 +1,566 @@
+
+#include "cpu-stream-kernels.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif // __x86_64__ || __i386__
+
+using namespace florentino;
+
+namespace {
+
+// Helpers of the kernels are always inlined, so they are compiled for the ISA
+// of the kernel they are used in, no matter which one they are declared for.
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+
+// Fully unroll the following loop. It must not run more iterations than the
+// largest unroll factor kernels are built for.
+#define UNROLL _Pragma("GCC unroll 8")
+
+// Unroll factors kernels are built for: the number of vectors processed by each
+// iteration of the main loop of a kernel. Keep in sync with addKernels.
+const unsigned UNROLLS[] = { 1, 2, 4, 8 };
+
+// A vector of Bytes bytes holding elements of type Ty, built on GCC vector
+// extensions. Operators work lane-wise, so the same kernel code is compiled for
+// all the element types, with as many lanes as the ISA allows. The compiler
+// picks the instructions for the element type: when the ISA has none -- e.g.
+// 64-bit integer multiplication before avx512dq -- they are emulated, and that
+// shows up as a lower bandwidth for that type.
+template <typename Ty, unsigned Bytes>
+class Vector {
+public:
+  typedef Ty Type __attribute__((vector_size(Bytes)));
+
+  static const unsigned Width = Bytes / sizeof(Ty);
+};
+
+// View the vector starting at the given element. The element must be aligned
+// to the size of the vector. A single element is viewed as itself.
+template <typename Vec, typename Ty>
+ALWAYS_INLINE Vec &at(Ty *addr) {
+  return *reinterpret_cast<Vec *>(addr);
+}
+
+template <typename Vec, typename Ty>
+ALWAYS_INLINE const Vec &at(const Ty *addr) {
+  return *reinterpret_cast<const Vec *>(addr);
+}
+
+// Add up the lanes of a vector.
+template <typename Vec, typename Ty>
+ALWAYS_INLINE Ty lanesSum(const Vec &vec) {
+  const Ty *lanes = reinterpret_cast<const Ty *>(&vec);
+  Ty sum = 0;
+
+  for(unsigned j = 0, e = sizeof(Vec) / sizeof(Ty); j != e; ++j)
+    sum += lanes[j];
+
+  return sum;
+}
+
+//
+// STREAM kernels, as operations computing the value to store in the target
+// array starting at element i. The value is either a vector or a single
+// element, so the same operation is used by all the loops of a kernel.
+//
+
+template <typename Ty>
+class CopyOp {
+public:
+  static ALWAYS_INLINE Ty *target(Ty *a, Ty *b, Ty *c) { return c; }
+
+  template <typename Val>
+  static ALWAYS_INLINE void apply(Val &val,
+                                  const Ty *a, const Ty *b, const Ty *c,
+                                  size_t i,
+                                  Ty k) {
+    // c[i] = a[i];
+    val = at<Val>(a + i);
+  }
+};
+
+template <typename Ty>
+class ScaleOp {
+public:
+  static ALWAYS_INLINE Ty *target(Ty *a, Ty *b, Ty *c) { return b; }
+
+  template <typename Val>
+  static ALWAYS_INLINE void apply(Val &val,
+                                  const Ty *a, const Ty *b, const Ty *c,
+                                  size_t i,
+                                  Ty k) {
+    // Actually k is a constant, but in the original benchmark it is stored in
+    // a variable -- probably the original author was interested in
+    // understanding whether the compiler is smart enough ...
+    //
+    // b[i] = k * c[i];
+    val = k * at<Val>(c + i);
+  }
+};
+
+template <typename Ty>
+class AddOp {
+public:
+  static ALWAYS_INLINE Ty *target(Ty *a, Ty *b, Ty *c) { return c; }
+
+  template <typename Val>
+  static ALWAYS_INLINE void apply(Val &val,
+                                  const Ty *a, const Ty *b, const Ty *c,
+                                  size_t i,
+                                  Ty k) {
+    // c[i] = a[i] + b[i];
+    val = at<Val>(a + i) + at<Val>(b + i);
+  }
+};
+
+template <typename Ty>
+class TriadOp {
+public:
+  static ALWAYS_INLINE Ty *target(Ty *a, Ty *b, Ty *c) { return a; }
+
+  template <typename Val>
+  static ALWAYS_INLINE void apply(Val &val,
+                                  const Ty *a, const Ty *b, const Ty *c,
+                                  size_t i,
+                                  Ty k) {
+    // See comment on ScaleOp.
+    //
+    // a[i] = b[i] + k * c[i];
+    val = at<Val>(b + i) + k * at<Val>(c + i);
+  }
+};
+
+template <typename Ty>
+class FillOp {
+public:
+  static ALWAYS_INLINE Ty *target(Ty *a, Ty *b, Ty *c) { return c; }
+
+  template <typename Val>
+  static ALWAYS_INLINE void apply(Val &val,
+                                  const Ty *a, const Ty *b, const Ty *c,
+                                  size_t i,
+                                  Ty k) {
+    // c[i] = k;
+    val = Val() + k;
+  }
+};
+
+// Apply Op to the [i, e) range: Unroll vectors at every iteration of the main
+// loop, then one vector at a time, then the remaining elements one at a time.
+// Vectors are stored through Isa, which knows how to issue non-temporal stores.
+template <typename Isa, typename Vec, typename Op, bool NonTemporal,
+          unsigned Unroll, typename Ty>
+ALWAYS_INLINE void streamLoop(Ty *a, Ty *b, Ty *c,
+                              size_t i, size_t e,
+                              Ty k) {
+  const size_t width = sizeof(Vec) / sizeof(Ty),
+               step = width * Unroll;
+
+  Ty *dst = Op::target(a, b, c);
+
+  for(size_t l = i + (e - i) / step * step; i != l; i += step) {
+    UNROLL
+    for(unsigned u = 0; u != Unroll; ++u) {
+      Vec val;
+
+      Op::apply(val, a, b, c, i + u * width, k);
+      Isa::template store<NonTemporal>(dst + i + u * width, val);
+    }
+  }
+
+  for(size_t l = i + (e - i) / width * width; i != l; i += width) {
+    Vec val;
+
+    Op::apply(val, a, b, c, i, k);
+    Isa::template store<NonTemporal>(dst + i, val);
+  }
+
+  for(; i != e; ++i)
+    Op::apply(dst[i], a, b, c, i, k);
+
+  // Make streaming stores globally visible before returning.
+  if(NonTemporal)
+    Isa::fence();
+}
+
+// Dot products are accumulated on the lanes of vectors for up to this many
+// iterations of the main loop, then the partial sum is added to the
+// accumulator of the element type. That bounds the rounding error of float
+// lanes, no matter the unroll factor.
+const size_t DOT_BLOCK_ITERATIONS = 64;
+
+// Dot product of the [i, e) range. The main loop accumulates on Unroll
+// independent vectors, so its additions do not wait for each other.
+template <typename Vec, unsigned Unroll, typename Ty>
+ALWAYS_INLINE typename ElementTraits<Ty>::Accumulator
+dotLoop(const Ty *a, const Ty *b, size_t i, size_t e) {
+  const size_t width = sizeof(Vec) / sizeof(Ty),
+               step = width * Unroll;
+
+  typename ElementTraits<Ty>::Accumulator sum = 0;
+
+  for(size_t l = i + (e - i) / step * step; i != l; ) {
+    size_t f = std::min(l, i + DOT_BLOCK_ITERATIONS * step);
+    Vec acc[Unroll];
+
+    UNROLL
+    for(unsigned u = 0; u != Unroll; ++u)
+      acc[u] = Vec();
+
+    for(; i != f; i += step) {
+      UNROLL
+      for(unsigned u = 0; u != Unroll; ++u)
+        acc[u] += at<Vec>(a + i + u * width) * at<Vec>(b + i + u * width);
+    }
+
+    Ty partial = 0;
+
+    UNROLL
+    for(unsigned u = 0; u != Unroll; ++u)
+      partial += lanesSum<Vec, Ty>(acc[u]);
+
+    sum += partial;
+  }
+
+  // Less than Unroll vectors are left, so there is no rounding error to bound.
+  Vec acc = Vec();
+
+  for(size_t l = i + (e - i) / width * width; i != l; i += width)
+    acc += at<Vec>(a + i) * at<Vec>(b + i);
+
+  Ty partial = lanesSum<Vec, Ty>(acc);
+
+  for(; i != e; ++i)
+    partial += a[i] * b[i];
+
+  return sum + partial;
+}
+
+// Initialization is not timed: kernels for all the ISAs share this one.
+template <typename Ty>
+void init(Ty *a, Ty *b, Ty *c,
+          size_t i, size_t e,
+          Ty k) {
+  for(; i != e; ++i) {
+    a[i] = 1;
+    b[i] = 2;
+    c[i] = 0;
+    a[i] *= 2;
+  }
+}
+
+//
+// Each ISA provides the store and fence instructions used by the loops, and
+// compiles them for all the unroll factors. Kernels are functions of the ISA
+// class, so that the loops can be compiled for the ISA.
+//
+
+//
+// Normal scalar implementation: vectors are single elements, and only regular
+// stores are available. Performance will not be good.
+//
+
+class Scalar {
+public:
+  static const char *name() { return "scalar"; }
+
+  static bool supported() { return true; }
+
+public:
+  template <bool NonTemporal, typename Ty>
+  static inline void store(Ty *addr, const Ty &val) {
+    *addr = val;
+  }
+
+  static inline void fence() { }
+
+public:
+  template <typename Ty, typename Op, bool NonTemporal, unsigned Unroll>
+  static void stream(Ty *a, Ty *b, Ty *c,
+                     size_t i, size_t e,
+                     Ty k) {
+    streamLoop<Scalar, Ty, Op, NonTemporal, Unroll>(a, b, c, i, e, k);
+  }
+
+  template <typename Ty, unsigned Unroll>
+  static typename ElementTraits<Ty>::Accumulator
+  dot(const Ty *a, const Ty *b, size_t i, size_t e) {
+    return dotLoop<Ty, Unroll>(a, b, i, e);
+  }
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Kernels for the other ISAs are compiled for that ISA only, no matter which
+// flags are passed to the compiler. They are called only if the running CPU
+// supports their ISA.
+#define SSE2_TARGET __attribute__((target("sse2")))
+#define AVX2_TARGET __attribute__((target("avx2")))
+#define AVX512_TARGET __attribute__((target("avx512f")))
+
+//
+// With sse2 we can vectorize operations using 16 bytes vectors, e.g. 2
+// doubles or 4 floats.
+//
+
+class SSE2 {
+public:
+  static const char *name() { return "sse2"; }
+
+  static bool supported() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+  }
+
+public:
+  // Non-temporal stores bypass the caches, hence they do not need to read the
+  // target cache line before writing it. They are issued as integer stores,
+  // that work for vectors of all the element types.
+  template <bool NonTemporal, typename Ty, typename Vec>
+  static SSE2_TARGET inline void store(Ty *addr, const Vec &val) {
+    if(NonTemporal)
+      _mm_stream_si128(reinterpret_cast<__m128i *>(addr), (__m128i) val);
+    else
+      at<Vec>(addr) = val;
+  }
+
+  static SSE2_TARGET inline void fence() { _mm_sfence(); }
+
+public:
+  template <typename Ty, typename Op, bool NonTemporal, unsigned Unroll>
+  static SSE2_TARGET void stream(Ty *a, Ty *b, Ty *c,
+                                 size_t i, size_t e,
+                                 Ty k) {
+    typedef typename Vector<Ty, 16>::Type Vec;
+
+    streamLoop<SSE2, Vec, Op, NonTemporal, Unroll>(a, b, c, i, e, k);
+  }
+
+  template <typename Ty, unsigned Unroll>
+  static SSE2_TARGET typename ElementTraits<Ty>::Accumulator
+  dot(const Ty *a, const Ty *b, size_t i, size_t e) {
+    typedef typename Vector<Ty, 16>::Type Vec;
+
+    return dotLoop<Vec, Unroll>(a, b, i, e);
+  }
+};
+
+//
+// With avx2 vectors hold 32 bytes, e.g. 4 doubles.
+//
+
+class AVX2 {
+public:
+  static const char *name() { return "avx2"; }
+
+  static bool supported() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+  }
+
+public:
+  template <bool NonTemporal, typename Ty, typename Vec>
+  static AVX2_TARGET inline void store(Ty *addr, const Vec &val) {
+    if(NonTemporal)
+      _mm256_stream_si256(reinterpret_cast<__m256i *>(addr), (__m256i) val);
+    else
+      at<Vec>(addr) = val;
+  }
+
+  static AVX2_TARGET inline void fence() { _mm_sfence(); }
+
+public:
+  template <typename Ty, typename Op, bool NonTemporal, unsigned Unroll>
+  static AVX2_TARGET void stream(Ty *a, Ty *b, Ty *c,
+                                 size_t i, size_t e,
+                                 Ty k) {
+    typedef typename Vector<Ty, 32>::Type Vec;
+
+    streamLoop<AVX2, Vec, Op, NonTemporal, Unroll>(a, b, c, i, e, k);
+  }
+
+  template <typename Ty, unsigned Unroll>
+  static AVX2_TARGET typename ElementTraits<Ty>::Accumulator
+  dot(const Ty *a, const Ty *b, size_t i, size_t e) {
+    typedef typename Vector<Ty, 32>::Type Vec;
+
+    return dotLoop<Vec, Unroll>(a, b, i, e);
+  }
+};
+
+//
+// With avx512 vectors hold 64 bytes: a whole cache line.
+//
+
+class AVX512 {
+public:
+  static const char *name() { return "avx512"; }
+
+  static bool supported() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512f");
+  }
+
+public:
+  template <bool NonTemporal, typename Ty, typename Vec>
+  static AVX512_TARGET inline void store(Ty *addr, const Vec &val) {
+    if(NonTemporal)
+      _mm512_stream_si512(reinterpret_cast<__m512i *>(addr), (__m512i) val);
+    else
+      at<Vec>(addr) = val;
+  }
+
+  static AVX512_TARGET inline void fence() { _mm_sfence(); }
+
+public:
+  template <typename Ty, typename Op, bool NonTemporal, unsigned Unroll>
+  static AVX512_TARGET void stream(Ty *a, Ty *b, Ty *c,
+                                   size_t i, size_t e,
+                                   Ty k) {
+    typedef typename Vector<Ty, 64>::Type Vec;
+
+    streamLoop<AVX512, Vec, Op, NonTemporal, Unroll>(a, b, c, i, e, k);
+  }
+
+  template <typename Ty, unsigned Unroll>
+  static AVX512_TARGET typename ElementTraits<Ty>::Accumulator
+  dot(const Ty *a, const Ty *b, size_t i, size_t e) {
+    typedef typename Vector<Ty, 64>::Type Vec;
+
+    return dotLoop<Vec, Unroll>(a, b, i, e);
+  }
+};
+
+#endif // __x86_64__ || __i386__
+
+#undef UNROLL
+#undef ALWAYS_INLINE
+
+// Instantiate the kernels of the given ISA, kind of stores, and unroll factor.
+// The dot kernel does not store, so it is the same for both kinds of stores.
+template <typename Isa, typename Ty, bool NonTemporal, unsigned Unroll>
+CPUKernels<Ty> buildKernels() {
+  CPUKernels<Ty> kernels = {
+    Isa::name(), NonTemporal, Unroll, Isa::supported,
+    init<Ty>,
+    Isa::template stream<Ty, CopyOp<Ty>, NonTemporal, Unroll>,
+    Isa::template stream<Ty, ScaleOp<Ty>, NonTemporal, Unroll>,
+    Isa::template stream<Ty, AddOp<Ty>, NonTemporal, Unroll>,
+    Isa::template stream<Ty, TriadOp<Ty>, NonTemporal, Unroll>,
+    Isa::template dot<Ty, Unroll>,
+    Isa::template stream<Ty, FillOp<Ty>, NonTemporal, Unroll>
+  };
+
+  return kernels;
+}
+
+template <typename Isa, typename Ty, bool NonTemporal>
+void addKernels(std::vector<CPUKernels<Ty> > &known) {
+  known.push_back(buildKernels<Isa, Ty, NonTemporal, 1>());
+  known.push_back(buildKernels<Isa, Ty, NonTemporal, 2>());
+  known.push_back(buildKernels<Isa, Ty, NonTemporal, 4>());
+  known.push_back(buildKernels<Isa, Ty, NonTemporal, 8>());
+}
+
+// Known kernels, from the most to the least advanced ISA. Scalar kernels are
+// always the last ones, as they run everywhere.
+template <typename Ty>
+const std::vector<CPUKernels<Ty> > &knownKernels() {
+  static std::vector<CPUKernels<Ty> > known;
+
+  if(known.empty()) {
+#if defined(__x86_64__) || defined(__i386__)
+    addKernels<AVX512, Ty, false>(known);
+    addKernels<AVX512, Ty, true>(known);
+    addKernels<AVX2, Ty, false>(known);
+    addKernels<AVX2, Ty, true>(known);
+    addKernels<SSE2, Ty, false>(known);
+    addKernels<SSE2, Ty, true>(known);
+#endif // __x86_64__ || __i386__
+    addKernels<Scalar, Ty, false>(known);
+  }
+
+  return known;
+}
+
+} // End anonymous namespace.
+
+std::vector<unsigned> florentino::cpuKernelsUnrolls() {
+  return std::vector<unsigned>(UNROLLS,
+                               UNROLLS + sizeof(UNROLLS) / sizeof(UNROLLS[0]));
+}
+
+template <typename Ty>
+const CPUKernels<Ty> &florentino::lookupCPUKernels(const std::string &isa,
+                                                   bool nonTemporal,
+                                                   unsigned unroll) {
+  typedef typename std::vector<CPUKernels<Ty> >::const_iterator iterator;
+
+  const std::vector<CPUKernels<Ty> > &known = knownKernels<Ty>();
+
+  bool found = false,
+       foundStores = false;
+
+  for(iterator i = known.begin(), e = known.end(); i != e; ++i) {
+    const CPUKernels<Ty> &kernels = *i;
+
+    if(isa != "auto" && isa != kernels._isa)
+      continue;
+
+    found = true;
+
+    if(kernels._nonTemporal != nonTemporal)
+      continue;
+
+    foundStores = true;
+
+    if(kernels._unroll != unroll)
+      continue;
+
+    if(kernels._supported())
+      return kernels;
+
+    if(isa != "auto") {
+      std::ostringstream os;
+      os << "Error: ISA '" << isa << "' not supported by this CPU";
+
+      throw std::runtime_error(os.str());
+    }
+  }
+
+  std::ostringstream os;
+
+  if(foundStores)
+    os << "Error: no kernels unrolled " << unroll << " times"
+       << " for ISA '" << isa << "'";
+  else if(found)
+    os << "Error: no " << (nonTemporal ? "non-temporal" : "regular")
+       << " kernels for ISA '" << isa << "'";
+  else
+    os << "Error: unknown ISA '" << isa << "'";
+
+  throw std::runtime_error(os.str());
+}
+
+// Kernels are built for all the supported element types.
+template const CPUKernels<float> &
+florentino::lookupCPUKernels<float>(const std::string &isa,
+                                    bool nonTemporal,
+                                    unsigned unroll);
+template const CPUKernels<double> &
+florentino::lookupCPUKernels<double>(const std::string &isa,
+                                     bool nonTemporal,
+                                     unsigned unroll);
+template const CPUKernels<Int32> &
+florentino::lookupCPUKernels<Int32>(const std::string &isa,
+                                    bool nonTemporal,
+                                    unsigned unroll);
+template const CPUKernels<Int64> &
+florentino::lookupCPUKernels<Int64>(const std::string &isa,
+                                    bool nonTemporal,
+                                    unsigned unroll);
@@ -0,0 +1,93 @@
+
+#ifndef CPU_STREAM_KERNELS_H
+#define CPU_STREAM_KERNELS_H
+
+#include "element-types.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+
+namespace florentino {
+
+// Chunks are made by whole cache lines. That keeps each chunk aligned to the
+// vector size, and prevents false sharing between threads.
+const size_t CACHE_LINE_SIZE = 64;
+
+// The STREAM kernels compiled for a given instruction set, working on arrays of
+// Ty elements. Timed kernels use either regular or non-temporal stores, and
+// their main loop processes an unroll factor of vectors per iteration, whose
+// width is the one of the ISA. Besides the four STREAM kernels, the dot
+// reduction only reads memory, while fill only writes it.
+template <typename Ty>
+class CPUKernels {
+public:
+  typedef typename ElementTraits<Ty>::Accumulator Accumulator;
+
+  // A STREAM kernel for the CPU. It works on the [i, e) range of the a, b, and
+  // c arrays. The range must start at an address aligned to 64 bytes. Not all
+  // the kernels use all the arguments, but sharing the signature allows
+  // dispatching all of them in the same way.
+  typedef void (*Kernel)(Ty *a, Ty *b, Ty *c, size_t i, size_t e, Ty k);
+
+  // A reduction for the CPU. It works on the [i, e) range of the a and b
+  // arrays, with the same alignment requirements of Kernel, and returns the
+  // partial result of the range.
+  typedef Accumulator (*Reduction)(const Ty *a, const Ty *b,
+                                   size_t i, size_t e);
+
+public:
+  const char *_isa;
+  bool _nonTemporal;
+  unsigned _unroll;
+  bool (*_supported)();
+
+  Kernel _init;
+  Kernel _copy;
+  Kernel _scale;
+  Kernel _add;
+  Kernel _triad;
+  Reduction _dot;
+  Kernel _fill;
+};
+
+// Get the unroll factors kernels are built for, in increasing order. They are
+// the same for all the ISAs.
+std::vector<unsigned> cpuKernelsUnrolls();
+
+// Get the kernels for the given ISA and unroll factor. The special "auto" ISA
+// selects the most advanced ISA supported by the running CPU. An exception is
+// thrown if the ISA is unknown, not supported, or it has no kernels with the
+// requested kind of stores or unroll factor. Kernels are available for all the
+// types described by ElementTraits.
+template <typename Ty>
+const CPUKernels<Ty> &lookupCPUKernels(const std::string &isa,
+                                       bool nonTemporal,
+                                       unsigned unroll = 1);
+
+// Split arrays of length Ty elements among count threads, and get the [i, e)
+// range of the thread with the given id. Cache lines are distributed as evenly
+// as possible, so every range satisfies the alignment required by kernels.
+template <typename Ty>
+void cpuKernelsChunk(size_t length,
+                     unsigned id,
+                     unsigned count,
+                     size_t &i,
+                     size_t &e) {
+  size_t lineLength = CACHE_LINE_SIZE / sizeof(Ty),
+         lines = (length + lineLength - 1) / lineLength,
+         linesPerThread = lines / count,
+         extraLines = lines % count;
+
+  size_t first = id * linesPerThread + std::min<size_t>(id, extraLines),
+         last = first + linesPerThread + (id < extraLines ? 1 : 0);
+
+  i = std::min(first * lineLength, length);
+  e = std::min(last * lineLength, length);
+}
+
+} // End namespace florentino.
+
+#endif // CPU_STREAM_KERNELS_H
@@ -1,166 +1,333 @@
-
 #include "cpu-stream.h"
 
+#include "florentino/clock.h"
 #include "florentino/memory.h"
 
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
 using namespace florentino;
 
-void CPUStream::teardown() {
-  StreamBench::teardown();
+namespace {
+
+// Runs timing each unroll factor of a kernel, when selecting the fastest one.
+// The best run is considered.
+const unsigned CALIBRATION_RUNS = 3;
+
+} // End anonymous namespace.
+
+//
+// CPUStream implementation.
+//
+
+template <typename Ty>
+void CPUStream<Ty>::setup() {
+  std::vector<unsigned> unrolls = cpuKernelsUnrolls();
+
+  // Look kernels up before allocating arrays, so errors are reported early. If
+  // the unroll factor is not set, these kernels are replaced by calibration.
+  const CPUKernels<Ty> &kernels = lookupCPUKernels<Ty>(isa(),
+                                                       _nonTemporal,
+                                                       unroll()
+                                                       ? unroll()
+                                                       : unrolls.front());
+  std::fill(_kernels, _kernels + KernelsCount, &kernels);
+
+  // Arrays and team are kept across the points of a sweep. Do not touch memory
+  // here: pages are mapped at initialization time, by the thread that is going
+  // to use them.
+  if(!_team) {
+    _allocLength = maxArrayLength();
+
+    _a = allocArray(_allocLength);
+    _b = allocArray(_allocLength);
+    _c = allocArray(_allocLength);
+
+    _team = new ThreadTeam(teamCPUs());
+    _partials = xaalloc<Partial>(_team->size(), CACHE_LINE_SIZE);
+  }
+
+  // Calibration streams arrays, so it must precede initialization.
+  std::vector<std::vector<double> > rates;
+  if(!unroll())
+    rates = calibrate();
+
+  StreamBench::setup();
+
+  // Arrays have been initialized, so pages are mapped.
+  std::string pages = describePages(_a);
+
+  parameter("isa", kernels._isa);
+  parameter("stores", _nonTemporal ? "non-temporal" : "regular");
+  parameter("threads", _team->size());
+  parameter("page-policy", pagePolicyName(pagePolicy()));
+  parameter("pages", pages);
+
+  if(unroll())
+    parameter("unroll", unroll());
+  else
+    parameter("unroll", "auto");
+
+  for(unsigned i = 0, e = KernelsCount; i != e; ++i)
+    parameter(kernelTag(StreamBench::Kernel(i)) + "-unroll",
+              _kernels[i]->_unroll);
+
+  log() << "Kernels ISA = " << kernels._isa
+        << std::endl
+        << "Stores = " << (_nonTemporal ? "non-temporal" : "regular")
+        << std::endl
+        << "Pages = " << pages
+        << " (" << pagePolicyName(pagePolicy()) << " policy)"
+        << std::endl
+        << "Number of threads = " << _team->size()
+        << std::endl
+        << "Threads pinning =";
+
+  for(unsigned i = 0, e = _team->size(); i != e; ++i)
+    log() << " " << i << ":" << _team->cpu(i);
 
-  xfree(_a);
-  xfree(_b);
-  xfree(_c);
+  log() << std::endl
+        << "Unroll factors =";
+
+  for(unsigned i = 0, e = KernelsCount; i != e; ++i)
+    log() << " " << kernelTag(StreamBench::Kernel(i))
+          << ":" << _kernels[i]->_unroll;
+
+  log() << (unroll() ? "" : " (auto)")
+        << std::endl
+
+        << hline;
+
+  if(rates.empty())
+    return;
+
+  // Report the rate of every variant, not just the selected ones.
+  log() << "Unroll calibration (best of " << CALIBRATION_RUNS << " runs, MB/s)"
+        << std::endl
+        << "Unroll";
+
+  for(unsigned i = 0, e = KernelsCount; i != e; ++i)
+    log() << std::setw(12) << kernelName(StreamBench::Kernel(i));
+
+  log() << std::endl;
+
+  for(unsigned j = 0, f = unrolls.size(); j != f; ++j) {
+    log() << std::setw(6) << unrolls[j];
+
+    for(unsigned i = 0, e = KernelsCount; i != e; ++i) {
+      std::ostringstream name;
+      name << kernelTag(StreamBench::Kernel(i))
+           << "-unroll-" << unrolls[j] << "-calibration-rate-MBps";
+
+      metric(name.str(), rates[i][j]);
+
+      log() << std::fixed << std::setprecision(1)
+            << std::setw(11) << rates[i][j]
+            << (_kernels[i]->_unroll == unrolls[j] ? "*" : " ");
+    }
+
+    log() << std::endl;
+  }
+
+  log() << hline;
 }
 
-void CPUStream::check(double k) {
-  StreamBench::check(_a, _b, _c, k);
+template <typename Ty>
+void CPUStream<Ty>::report() {
+  log() << " " << _kernels[Copy]->_isa;
+
+  StreamBench::report();
 }
 
-// With sse2 we can vectorize operations using vectors of 2 doubles.
-#if defined(__SSE2__)
+template <typename Ty>
+CPUStream<Ty>::~CPUStream() {
+  // Subclasses free arrays as CPUStream does, whatever node they are bound to:
+  // calling the base freeArray from here is fine.
+  if(_team || _a)
+    release();
+}
 
-#include <emmintrin.h>
+template <typename Ty>
+void CPUStream<Ty>::release() {
+  delete _team;
+  _team = 0;
 
-#define KERNEL(K, E)               \
-  unsigned i = 0,                  \
-           e = arrayLength() & ~1; \
-                                   \
-  for(; i != e; i += 2) { K }      \
-  if(i != arrayLength()) { E }
+  xfree(_partials);
+  _partials = 0;
 
-void CPUStream::setup() {
-  _a = xacalloc<double>(arrayLength(), __alignof__(__v2df));
-  _b = xacalloc<double>(arrayLength(), __alignof__(__v2df));
-  _c = xacalloc<double>(arrayLength(), __alignof__(__v2df));
+  freeArray(_a, _allocLength);
+  freeArray(_b, _allocLength);
+  freeArray(_c, _allocLength);
 
-  StreamBench::setup();
+  _a = _b = _c = 0;
+  _allocLength = 0;
 }
 
-void CPUStream::init() {
-  KERNEL(
-  {
-    // _a[i] = 1.0;
-    _mm_store_pd(_a + i, _mm_set1_pd(1.0));
-
-    // _b[i] = 2.0;
-    _mm_store_pd(_b + i, _mm_set1_pd(2.0));
-
-    // _c[i] = 0.0;
-    _mm_store_pd(_c + i, _mm_set1_pd(0.0));
-
-    // _a[i] *= 2.0;
-    _mm_store_pd(_a + i, _mm_mul_pd(_mm_set1_pd(2.0), _mm_load_pd(_a + i)));
-  },
-  {
-    // _a[i] = 1.0;
-    _mm_store_sd(_a + i, _mm_set_sd(1.0));
-
-    // _b[i] = 2.0;
-    _mm_store_sd(_b + i, _mm_set_sd(2.0));
-
-    // _c[i] = 0.0;
-    _mm_store_sd(_c + i, _mm_set_sd(0.0));
-
-    // _a[i] *= 2.0;
-    _mm_store_sd(_a + i, _mm_mul_sd(_mm_set_sd(2.0), _mm_load_sd(_a + i)));
-  })
-}
-void CPUStream::copy() {
-  KERNEL(
-  {
-    // _c[i] = _a[i];
-    _mm_store_pd(_c + i, _mm_load_pd(_a + i));
-  },
-  {
-    // _c[i] = _a[i];
-    _mm_store_sd(_c + i, _mm_load_sd(_a + i));
-  })
-}
-
-void CPUStream::scale(double k) {
-  KERNEL(
-  {
-    // _b[i] = k * _c[i];
-    _mm_store_pd(_b + i, _mm_mul_pd(_mm_set1_pd(k), _mm_load_pd(_c + i)));
-  },
-  {
-    // _b[i] = k * _c[i];
-    _mm_store_sd(_b + i, _mm_mul_sd(_mm_set_sd(k), _mm_load_sd(_c + i)));
-  })
-}
-
-void CPUStream::add() {
-  KERNEL(
-  {
-    //_c[i] = _a[i] + _b[i];
-    _mm_store_pd(_c + i, _mm_add_pd(_mm_load_pd(_a + i), _mm_load_pd(_b + i)));
-  },
-  {
-    //_c[i] = _a[i] + _b[i];
-    _mm_store_sd(_c + i, _mm_add_sd(_mm_load_sd(_a + i), _mm_load_sd(_b + i)));
-  })
-}
-
-void CPUStream::triad(double k) {
-  KERNEL(
-  {
-    // _a[i] = _b[i] + k * _c[i];
-    _mm_store_pd(_a + i,
-                 _mm_add_pd(_mm_load_pd(_b + i),
-                            _mm_mul_pd(_mm_set1_pd(k), _mm_load_pd(_c + i))));
-  },
-  {
-    // _a[i] = _b[i] + k * _c[i];
-    _mm_store_sd(_a + i,
-                 _mm_add_sd(_mm_load_sd(_b + i),
-                            _mm_mul_sd(_mm_set_sd(k), _mm_load_sd(_c + i))));
-  })
-}
-
-// Normal scalar implementation. Performance will not be good, and it is
-// unlikely the compiler can vectorize the code.
-#else
-
-void CPUStream::setup() {
-  _a = xcalloc<double>(arrayLength());
-  _b = xcalloc<double>(arrayLength());
-  _c = xcalloc<double>(arrayLength());
+template <typename Ty>
+void CPUStream<Ty>::init() {
+  // Initialization is the same for all the unroll factors.
+  parallel(_kernels[Copy]->_init);
+}
 
-  StreamBench::setup();
+template <typename Ty>
+void CPUStream<Ty>::copy() {
+  parallel(_kernels[Copy]->_copy);
+}
+
+template <typename Ty>
+void CPUStream<Ty>::scale(double k) {
+  parallel(_kernels[Scale]->_scale, k);
+}
+
+template <typename Ty>
+void CPUStream<Ty>::add() {
+  parallel(_kernels[Add]->_add);
+}
+
+template <typename Ty>
+void CPUStream<Ty>::triad(double k) {
+  parallel(_kernels[Triad]->_triad, k);
+}
+
+template <typename Ty>
+void CPUStream<Ty>::dot() {
+  _team->run(dispatchDot, this);
+
+  Accumulator sum = 0;
+
+  for(unsigned i = 0, e = _team->size(); i != e; ++i)
+    sum += _partials[i]._value;
+
+  _dot = sum;
 }
 
-void CPUStream::init() {
-  for(unsigned i = 0, e = arrayLength(); i != e; ++i) {
-    _a[i] = 1.0;
-    _b[i] = 2.0;
-    _c[i] = 0.0;
-    _a[i] *= 2.0;
+template <typename Ty>
+void CPUStream<Ty>::fill(double k) {
+  parallel(_kernels[Fill]->_fill, k);
+}
+
+template <typename Ty>
+void CPUStream<Ty>::check(double k) {
+  StreamBench::check(_a, _b, _c, Ty(k), _dot, *_team);
+}
+
+template <typename Ty>
+std::vector<std::vector<double> > CPUStream<Ty>::calibrate() {
+  std::vector<unsigned> unrolls = cpuKernelsUnrolls();
+  std::vector<const CPUKernels<Ty> *> variants;
+
+  for(unsigned j = 0, f = unrolls.size(); j != f; ++j)
+    variants.push_back(&lookupCPUKernels<Ty>(isa(), _nonTemporal, unrolls[j]));
+
+  // Map pages, and warm caches up, before timing anything.
+  std::fill(_kernels, _kernels + KernelsCount, variants.front());
+  init();
+
+  std::vector<std::vector<double> > rates(KernelsCount);
+  unsigned n = passes();
+
+  for(unsigned i = 0, e = KernelsCount; i != e; ++i) {
+    StreamBench::Kernel kernel = StreamBench::Kernel(i);
+    size_t totalSize = kernelBytes(kernel) * arrayLength() * n;
+
+    const CPUKernels<Ty> *best = variants.front();
+    double bestRate = 0.0;
+
+    for(unsigned j = 0, f = variants.size(); j != f; ++j) {
+      unsigned long long minTicks =
+        std::numeric_limits<unsigned long long>::max();
+
+      _kernels[i] = variants[j];
+      runKernel(kernel);
+
+      for(unsigned r = 0; r != CALIBRATION_RUNS; ++r) {
+        unsigned long long start = ClockSource::read();
+
+        for(unsigned p = 0; p != n; ++p)
+          runKernel(kernel);
+
+        minTicks = std::min(minTicks, ClockSource::read() - start);
+      }
+
+      double rate = totalSize * 1e-6 /
+                    std::max(minTicks * ClockSource::period(),
+                             ClockSource::resolution());
+
+      rates[i].push_back(rate);
+
+      if(rate > bestRate) {
+        best = variants[j];
+        bestRate = rate;
+      }
+    }
+
+    _kernels[i] = best;
   }
+
+  return rates;
+}
+
+template <typename Ty>
+Ty *CPUStream<Ty>::allocArray(size_t length) {
+  return xpalloc<Ty>(length, pagePolicy());
+}
+
+template <typename Ty>
+void CPUStream<Ty>::freeArray(Ty *arr, size_t length) {
+  xpfree(arr, length, pagePolicy());
+}
+
+template <typename Ty>
+std::vector<unsigned> CPUStream<Ty>::teamCPUs() {
+  return ThreadTeam::spread(ThreadTeam::availableCPUs(), threadsCount());
 }
 
-void CPUStream::copy() {
-  for(unsigned i = 0, e = arrayLength(); i != e; ++i)
-    _c[i] = _a[i];
+template <typename Ty>
+void CPUStream<Ty>::parallel(Kernel kernel, double k) {
+  Job job(this, kernel, Ty(k));
+
+  _team->run(dispatch, &job);
 }
 
-void CPUStream::scale(double k) {
-  // Actually k is a constant, but in the original benchmark it is stored in a
-  // variable -- probably the original author was interested in understanding
-  // whether the compiler is smart enough ...
-  for(unsigned i = 0, e = arrayLength(); i != e; ++i)
-    _b[i] = k * _c[i];
+template <typename Ty>
+void CPUStream<Ty>::dispatch(void *arg, unsigned id, unsigned count) {
+  Job *job = reinterpret_cast<Job *>(arg);
+  CPUStream *stream = job->_stream;
+
+  size_t i, e;
+  stream->chunk(id, count, i, e);
+
+  if(i != e)
+    job->_kernel(stream->_a, stream->_b, stream->_c, i, e, job->_k);
 }
 
-void CPUStream::add() {
-  for(unsigned i = 0, e = arrayLength(); i != e; ++i)
-    _c[i] = _a[i] + _b[i];
+template <typename Ty>
+void CPUStream<Ty>::dispatchDot(void *arg, unsigned id, unsigned count) {
+  CPUStream *stream = reinterpret_cast<CPUStream *>(arg);
+
+  size_t i, e;
+  stream->chunk(id, count, i, e);
+
+  stream->_partials[id]._value = i != e
+                                 ? stream->_kernels[Dot]->_dot(stream->_a,
+                                                               stream->_b,
+                                                               i,
+                                                               e)
+                                 : 0;
 }
 
-void CPUStream::triad(double k) {
-  // See comment on CPUStream::scale.
-  for(unsigned i = 0, e = arrayLength(); i != e; ++i)
-    _a[i] = _b[i] + k * _c[i];
+template <typename Ty>
+void CPUStream<Ty>::chunk(unsigned id,
+                          unsigned count,
+                          size_t &i,
+                          size_t &e) const {
+  cpuKernelsChunk<Ty>(arrayLength(), id, count, i, e);
 }
 
-#endif // SCALAR_IMPLEMENTATION
+// Benchmarks are built for all the supported element types.
+template class florentino::CPUStream<float>;
+template class florentino::CPUStream<double>;
+template class florentino::CPUStream<Int32>;
+template class florentino::CPUStream<Int64>;
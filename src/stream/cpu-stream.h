@@ -3,23 +3,78 @@
 #define CPU_STREAM_H
 
 #include "benchmarks.h"
+#include "cpu-stream-kernels.h"
+
+#include "florentino/thread.h"
+
+#include <algorithm>
 
 #include <cstdlib>
 
 namespace florentino {
 
-// Execute STREAM on the CPU, employing just 1 thread.
+// Execute STREAM on the CPU. Arrays are split in chunks, one for each thread of
+// a team. Each thread is pinned to a CPU and it always works on the same chunk,
+// initialization included. In this way the memory of a chunk is mapped on the
+// NUMA node of the thread that is going to stream it. Arrays hold elements of
+// type Ty.
+template <typename Ty>
 class CPUStream : public StreamBench {
 public:
-  CPUStream(StreamBenchmarkRunner &runner)
-    : StreamBench("CPU-STREAM", runner),
+  typedef typename CPUKernels<Ty>::Kernel Kernel;
+  typedef typename CPUKernels<Ty>::Accumulator Accumulator;
+
+public:
+  // Timed kernels can write arrays either with regular or non-temporal stores.
+  // The latter version must be explicitly enabled from the command line.
+  CPUStream(StreamBenchmarkRunner &runner, bool nonTemporal = false)
+    : StreamBench(nonTemporal ? "CPU-STREAM-NT" : "CPU-STREAM",
+                  runner,
+                  ElementTraits<Ty>::name(),
+                  sizeof(Ty)),
+      _nonTemporal(nonTemporal),
+      _a(0),
+      _b(0),
+      _c(0),
+      _allocLength(0),
+      _team(0),
+      _partials(0),
+      _dot(0) {
+    std::fill(_kernels, _kernels + KernelsCount,
+              static_cast<const CPUKernels<Ty> *>(0));
+  }
+
+protected:
+  CPUStream(const std::string &nm, StreamBenchmarkRunner &runner)
+    : StreamBench(nm, runner, ElementTraits<Ty>::name(), sizeof(Ty)),
+      _nonTemporal(false),
       _a(0),
       _b(0),
-      _c(0) { }
+      _c(0),
+      _allocLength(0),
+      _team(0),
+      _partials(0),
+      _dot(0) {
+    std::fill(_kernels, _kernels + KernelsCount,
+              static_cast<const CPUKernels<Ty> *>(0));
+  }
+
+  // Resources are normally freed by release(), but an exception thrown by a
+  // run -- e.g. by validation -- skips it.
+  virtual ~CPUStream();
 
 public:
   virtual void setup();
-  virtual void teardown();
+  virtual void report();
+  virtual void release();
+
+public:
+  virtual bool enabled() const {
+    StreamBenchmarkRunner &runner = Benchmark::runner<StreamBenchmarkRunner>();
+    return StreamBench::enabled() && (!_nonTemporal || runner.nonTemporal());
+  }
+
+  bool nonTemporal() const { return _nonTemporal; }
 
 protected:
   virtual void init();
@@ -27,13 +82,76 @@ protected:
   virtual void scale(double k);
   virtual void add();
   virtual void triad(double k);
+  virtual void dot();
+  virtual void fill(double k);
 
   virtual void check(double k);
 
+protected:
+  // Allocate an array of length elements, and release it. Memory must be
+  // aligned to a cache line, and backed by pages of the selected kind.
+  virtual Ty *allocArray(size_t length);
+  virtual void freeArray(Ty *arr, size_t length);
+
+  // The CPUs where team members are pinned, one for each thread.
+  virtual std::vector<unsigned> teamCPUs();
+
 private:
-  double *_a;
-  double *_b;
-  double *_c;
+  // Time every unroll factor of each kernel, and select the fastest one. Arrays
+  // are initialized, so they must have been allocated. Return the rates of all
+  // the factors, by kernel.
+  std::vector<std::vector<double> > calibrate();
+
+  // Run kernel on all the threads of the team, and wait for its termination.
+  void parallel(Kernel kernel, double k = 0.0);
+
+  static void dispatch(void *arg, unsigned id, unsigned count);
+  static void dispatchDot(void *arg, unsigned id, unsigned count);
+
+  // The range of the arrays processed by the given team member.
+  void chunk(unsigned id, unsigned count, size_t &i, size_t &e) const;
+
+private:
+  // What is needed by a team member to run its share of a kernel.
+  class Job {
+  public:
+    Job(CPUStream *stream, Kernel kernel, Ty k) : _stream(stream),
+                                                  _kernel(kernel),
+                                                  _k(k) { }
+
+  public:
+    CPUStream *_stream;
+    Kernel _kernel;
+    Ty _k;
+  };
+
+  // Partial result of a reduction computed by a team member. Each partial
+  // fills a cache line, and partials are allocated aligned to a cache line, so
+  // members do not share lines.
+  class Partial {
+  public:
+    Accumulator _value;
+    char _padding[CACHE_LINE_SIZE - sizeof(Accumulator)];
+  };
+
+private:
+  bool _nonTemporal;
+
+  Ty *_a;
+  Ty *_b;
+  Ty *_c;
+  size_t _allocLength;
+
+  ThreadTeam *_team;
+
+  // The kernels used by each operation. They share the ISA and the kind of
+  // stores, but the unroll factor can be different.
+  const CPUKernels<Ty> *_kernels[KernelsCount];
+
+  Partial *_partials;
+
+  // Result of the last dot, checked at validation time.
+  Accumulator _dot;
 };
 
 } // End namespace florentino.
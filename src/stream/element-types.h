@@ -0,0 +1,71 @@
+
+#ifndef ELEMENT_TYPES_H
+#define ELEMENT_TYPES_H
+
+#include <stdint.h>
+
+namespace florentino {
+
+// Integer arrays are streamed as unsigned values: STREAM kernels overflow after
+// a few runs, and unsigned arithmetic wraps around in a well defined way, which
+// can be reproduced at validation time. Signedness does not change bandwidth.
+typedef uint32_t Int32;
+typedef uint64_t Int64;
+
+// Describe a type of array elements STREAM can be run on. For each type:
+//
+// - Accumulator: the type reductions are accumulated in
+// - name: the name used on the command line and in reports
+// - openCLName: the corresponding OpenCL C type
+// - tolerance: relative error accepted by validation, 0 for exact results
+template <typename Ty>
+class ElementTraits;
+
+template <>
+class ElementTraits<float> {
+public:
+  // Summing millions of floats in a float accumulator loses precision.
+  typedef double Accumulator;
+
+  static const char *name() { return "float"; }
+  static const char *openCLName() { return "float"; }
+
+  static double tolerance() { return 1e-5; }
+};
+
+template <>
+class ElementTraits<double> {
+public:
+  typedef double Accumulator;
+
+  static const char *name() { return "double"; }
+  static const char *openCLName() { return "double"; }
+
+  static double tolerance() { return 1e-8; }
+};
+
+template <>
+class ElementTraits<Int32> {
+public:
+  typedef Int32 Accumulator;
+
+  static const char *name() { return "int32"; }
+  static const char *openCLName() { return "uint"; }
+
+  static double tolerance() { return 0.0; }
+};
+
+template <>
+class ElementTraits<Int64> {
+public:
+  typedef Int64 Accumulator;
+
+  static const char *name() { return "int64"; }
+  static const char *openCLName() { return "ulong"; }
+
+  static double tolerance() { return 0.0; }
+};
+
+} // End namespace florentino.
+
+#endif // ELEMENT_TYPES_H
@@ -1,69 +1,405 @@
 
+// Kernels work on arrays of ELEMENT, defined by the host when building the
+// program. Integer types are unsigned, so overflows wrap around.
+#ifndef ELEMENT
+#define ELEMENT double
+#define ELEMENT_FP64
+#endif
+
+#ifdef ELEMENT_FP64
 #ifdef cl_khr_fp64
 #pragma OPENCL EXTENSION cl_khr_fp64 : enable
 #else
 #error "double precision floating point not supported by OpenCL implementation"
 #endif
+#endif
 
 // NOTE: I prefered guarding all benchmarks with a loop rather than with a
 // conditional, just in the case I want to increase the number of iterations
 // performed by each kernel.
+//
+// Lengths and indices are 64-bit wide, so arrays can hold more than 4G
+// elements.
+
+kernel void gpu_init(global ELEMENT * restrict a,
+                     global ELEMENT * restrict b,
+                     global ELEMENT * restrict c,
+                     ulong n)
+{
+  ulong stride = get_global_size(0);
+
+  for(ulong i = get_global_id(0); i < n; i += stride) {
+    a[i] = 1;
+    b[i] = 2;
+    c[i] = 0;
+    a[i] *= 2 * a[i];
+  }
+}
+
+kernel void gpu_copy(global ELEMENT * restrict a,
+                     global ELEMENT * restrict c,
+                     ulong n)
+{
+  ulong stride = get_global_size(0);
+
+  for(ulong i = get_global_id(0); i < n; i += stride)
+    c[i] = a[i];
+}
+
+kernel void gpu_scale(global ELEMENT * restrict b,
+                      global ELEMENT * restrict c,
+                      ELEMENT k,
+                      ulong n)
+{
+  ulong stride = get_global_size(0);
+
+  for(ulong i = get_global_id(0); i < n; i += stride)
+    b[i] = k * c[i];
+}
+
+kernel void gpu_add(global ELEMENT * restrict a,
+                    global ELEMENT * restrict b,
+                    global ELEMENT * restrict c,
+                    ulong n)
+{
+  ulong stride = get_global_size(0);
+
+  for(ulong i = get_global_id(0); i < n; i += stride)
+    c[i] = a[i] + b[i];
+}
+
+kernel void gpu_triad(global ELEMENT * restrict a,
+                      global ELEMENT * restrict b,
+                      global ELEMENT * restrict c,
+                      ELEMENT k,
+                      ulong n)
+{
+  ulong stride = get_global_size(0);
+
+  for(ulong i = get_global_id(0); i < n; i += stride)
+    a[i] = b[i] + k * c[i];
+}
+
+// Reduce the sums of the work items of a work group in local memory. It works
+// with any work group size: when the active size is odd, the middle element is
+// just carried on.
+void gpu_reduce(local ELEMENT * restrict scratch,
+                global ELEMENT * restrict sums,
+                ELEMENT sum)
+{
+  uint lid = get_local_id(0);
+
+  scratch[lid] = sum;
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  for(uint size = get_local_size(0); size > 1; ) {
+    uint half = (size + 1) / 2;
+
+    if(lid + half < size)
+      scratch[lid] += scratch[lid + half];
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    size = half;
+  }
+
+  // One partial sum for each work group, reduced by the host.
+  if(lid == 0)
+    sums[get_group_id(0)] = scratch[0];
+}
+
+kernel void gpu_dot(global const ELEMENT * restrict a,
+                    global const ELEMENT * restrict b,
+                    global ELEMENT * restrict sums,
+                    local ELEMENT * restrict scratch,
+                    ulong n)
+{
+  ulong stride = get_global_size(0);
 
-kernel void gpu_init(global double * restrict a,
-                     global double * restrict b,
-                     global double * restrict c,
-                     uint n)
+  ELEMENT sum = 0;
+
+  for(ulong i = get_global_id(0); i < n; i += stride)
+    sum += a[i] * b[i];
+
+  gpu_reduce(scratch, sums, sum);
+}
+
+kernel void gpu_fill(global ELEMENT * restrict c,
+                     ELEMENT k,
+                     ulong n)
+{
+  ulong stride = get_global_size(0);
+
+  for(ulong i = get_global_id(0); i < n; i += stride)
+    c[i] = k;
+}
+
+#define CONCAT_(A, B) A ## B
+#define CONCAT(A, B) CONCAT_(A, B)
+
+// Variants of the GPU kernels working on vectors of W elements, selected by the
+// host autotuner: gpu_copy2, gpu_copy4, and so on. Arrays are accessed through
+// vector pointers, as buffers are aligned to the largest vector type. Work
+// items first stride over whole vectors, then over the elements of the tail.
+#define GPU_VECTOR_KERNELS(W)                                                \
+kernel void gpu_copy ## W(global ELEMENT * restrict a,                       \
+                          global ELEMENT * restrict c,                       \
+                          ulong n)                                           \
+{                                                                            \
+  global CONCAT(ELEMENT, W) *av = (global CONCAT(ELEMENT, W) *) a,           \
+                            *cv = (global CONCAT(ELEMENT, W) *) c;           \
+  ulong stride = get_global_size(0), vectors = n / W;                        \
+                                                                             \
+  for(ulong i = get_global_id(0); i < vectors; i += stride)                  \
+    cv[i] = av[i];                                                           \
+                                                                             \
+  for(ulong i = vectors * W + get_global_id(0); i < n; i += stride)          \
+    c[i] = a[i];                                                             \
+}                                                                            \
+                                                                             \
+kernel void gpu_scale ## W(global ELEMENT * restrict b,                      \
+                           global ELEMENT * restrict c,                      \
+                           ELEMENT k,                                        \
+                           ulong n)                                          \
+{                                                                            \
+  global CONCAT(ELEMENT, W) *bv = (global CONCAT(ELEMENT, W) *) b,           \
+                            *cv = (global CONCAT(ELEMENT, W) *) c;           \
+  ulong stride = get_global_size(0), vectors = n / W;                        \
+                                                                             \
+  for(ulong i = get_global_id(0); i < vectors; i += stride)                  \
+    bv[i] = k * cv[i];                                                       \
+                                                                             \
+  for(ulong i = vectors * W + get_global_id(0); i < n; i += stride)          \
+    b[i] = k * c[i];                                                         \
+}                                                                            \
+                                                                             \
+kernel void gpu_add ## W(global ELEMENT * restrict a,                        \
+                         global ELEMENT * restrict b,                        \
+                         global ELEMENT * restrict c,                        \
+                         ulong n)                                            \
+{                                                                            \
+  global CONCAT(ELEMENT, W) *av = (global CONCAT(ELEMENT, W) *) a,           \
+                            *bv = (global CONCAT(ELEMENT, W) *) b,           \
+                            *cv = (global CONCAT(ELEMENT, W) *) c;           \
+  ulong stride = get_global_size(0), vectors = n / W;                        \
+                                                                             \
+  for(ulong i = get_global_id(0); i < vectors; i += stride)                  \
+    cv[i] = av[i] + bv[i];                                                   \
+                                                                             \
+  for(ulong i = vectors * W + get_global_id(0); i < n; i += stride)          \
+    c[i] = a[i] + b[i];                                                      \
+}                                                                            \
+                                                                             \
+kernel void gpu_triad ## W(global ELEMENT * restrict a,                      \
+                           global ELEMENT * restrict b,                      \
+                           global ELEMENT * restrict c,                      \
+                           ELEMENT k,                                        \
+                           ulong n)                                          \
+{                                                                            \
+  global CONCAT(ELEMENT, W) *av = (global CONCAT(ELEMENT, W) *) a,           \
+                            *bv = (global CONCAT(ELEMENT, W) *) b,           \
+                            *cv = (global CONCAT(ELEMENT, W) *) c;           \
+  ulong stride = get_global_size(0), vectors = n / W;                        \
+                                                                             \
+  for(ulong i = get_global_id(0); i < vectors; i += stride)                  \
+    av[i] = bv[i] + k * cv[i];                                               \
+                                                                             \
+  for(ulong i = vectors * W + get_global_id(0); i < n; i += stride)          \
+    a[i] = b[i] + k * c[i];                                                  \
+}                                                                            \
+                                                                             \
+kernel void gpu_dot ## W(global const ELEMENT * restrict a,                  \
+                         global const ELEMENT * restrict b,                  \
+                         global ELEMENT * restrict sums,                     \
+                         local ELEMENT * restrict scratch,                   \
+                         ulong n)                                            \
+{                                                                            \
+  global const CONCAT(ELEMENT, W)                                            \
+    *av = (global const CONCAT(ELEMENT, W) *) a,                             \
+    *bv = (global const CONCAT(ELEMENT, W) *) b;                             \
+  ulong stride = get_global_size(0), vectors = n / W;                        \
+                                                                             \
+  CONCAT(ELEMENT, W) acc = (CONCAT(ELEMENT, W))(0);                          \
+  ELEMENT sum = 0;                                                           \
+                                                                             \
+  for(ulong i = get_global_id(0); i < vectors; i += stride)                  \
+    acc += av[i] * bv[i];                                                    \
+                                                                             \
+  for(ulong i = vectors * W + get_global_id(0); i < n; i += stride)          \
+    sum += a[i] * b[i];                                                      \
+                                                                             \
+  /* Add up the lanes of the accumulator. */                                 \
+  ELEMENT lanes[W];                                                          \
+  CONCAT(vstore, W)(acc, 0, lanes);                                          \
+                                                                             \
+  for(uint j = 0; j < W; ++j)                                                \
+    sum += lanes[j];                                                         \
+                                                                             \
+  gpu_reduce(scratch, sums, sum);                                            \
+}                                                                            \
+                                                                             \
+kernel void gpu_fill ## W(global ELEMENT * restrict c,                       \
+                          ELEMENT k,                                         \
+                          ulong n)                                           \
+{                                                                            \
+  global CONCAT(ELEMENT, W) *cv = (global CONCAT(ELEMENT, W) *) c;           \
+  CONCAT(ELEMENT, W) kv = (CONCAT(ELEMENT, W))(k);                           \
+  ulong stride = get_global_size(0), vectors = n / W;                        \
+                                                                             \
+  for(ulong i = get_global_id(0); i < vectors; i += stride)                  \
+    cv[i] = kv;                                                              \
+                                                                             \
+  for(ulong i = vectors * W + get_global_id(0); i < n; i += stride)          \
+    c[i] = k;                                                                \
+}
+
+GPU_VECTOR_KERNELS(2)
+GPU_VECTOR_KERNELS(4)
+GPU_VECTOR_KERNELS(8)
+
+#undef GPU_VECTOR_KERNELS
+
+// Kernels for CPU devices work on vectors of VECTOR_WIDTH elements -- a cache
+// line -- defined by the host as well.
+#ifndef VECTOR_WIDTH
+#define VECTOR_WIDTH 8
+#endif
+
+#define VECTOR CONCAT(ELEMENT, VECTOR_WIDTH)
+#define VLOAD CONCAT(vload, VECTOR_WIDTH)
+#define VSTORE CONCAT(vstore, VECTOR_WIDTH)
+
+// On CPUs each work item streams a contiguous chunk of the arrays, as a thread
+// of the native benchmark does. Chunks are made by whole vectors, except the
+// last one. The [i, l) range of the chunk is processed by vectors, while the
+// [l, e) range is processed one element at a time.
+void cpu_chunk(ulong n, ulong *i, ulong *l, ulong *e)
+{
+  ulong items = get_global_size(0),
+        vectors = (n + VECTOR_WIDTH - 1) / VECTOR_WIDTH,
+        share = (vectors + items - 1) / items;
+
+  *i = min(n, get_global_id(0) * share * VECTOR_WIDTH);
+  *e = min(n, *i + share * VECTOR_WIDTH);
+  *l = *i + (*e - *i) / VECTOR_WIDTH * VECTOR_WIDTH;
+}
+
+kernel void cpu_init(global ELEMENT * restrict a,
+                     global ELEMENT * restrict b,
+                     global ELEMENT * restrict c,
+                     ulong n)
 {
-  uint stride = get_global_size(0);
+  ulong i, l, e;
+  cpu_chunk(n, &i, &l, &e);
 
-  for(uint i = get_global_id(0); i < n; i += stride) {
-    a[i] = 1.0;
-    b[i] = 2.0;
-    c[i] = 0.0;
-    a[i] *= 2.0E0 * a[i];
+  // Not timed: just map pages on the work item streaming them.
+  for(; i < e; ++i) {
+    a[i] = 1;
+    b[i] = 2;
+    c[i] = 0;
+    a[i] *= 2 * a[i];
   }
 }
 
-kernel void gpu_copy(global double * restrict a,
-                     global double * restrict c,
-                     uint n)
+kernel void cpu_copy(global ELEMENT * restrict a,
+                     global ELEMENT * restrict c,
+                     ulong n)
 {
-  uint stride = get_global_size(0);
+  ulong i, l, e;
+  cpu_chunk(n, &i, &l, &e);
 
-  for(uint i = get_global_id(0); i < n; i += stride)
+  for(; i < l; i += VECTOR_WIDTH)
+    VSTORE(VLOAD(0, a + i), 0, c + i);
+
+  for(; i < e; ++i)
     c[i] = a[i];
 }
 
-kernel void gpu_scale(global double * restrict b,
-                      global double * restrict c,
-                      double k,
-                      uint n)
+kernel void cpu_scale(global ELEMENT * restrict b,
+                      global ELEMENT * restrict c,
+                      ELEMENT k,
+                      ulong n)
 {
-  uint stride = get_global_size(0);
+  ulong i, l, e;
+  cpu_chunk(n, &i, &l, &e);
+
+  for(; i < l; i += VECTOR_WIDTH)
+    VSTORE(k * VLOAD(0, c + i), 0, b + i);
 
-  for(uint i = get_global_id(0); i < n; i += stride)
+  for(; i < e; ++i)
     b[i] = k * c[i];
 }
 
-kernel void gpu_add(global double * restrict a,
-                    global double * restrict b,
-                    global double * restrict c,
-                    uint n)
+kernel void cpu_add(global ELEMENT * restrict a,
+                    global ELEMENT * restrict b,
+                    global ELEMENT * restrict c,
+                    ulong n)
 {
-  uint stride = get_global_size(0);
+  ulong i, l, e;
+  cpu_chunk(n, &i, &l, &e);
+
+  for(; i < l; i += VECTOR_WIDTH)
+    VSTORE(VLOAD(0, a + i) + VLOAD(0, b + i), 0, c + i);
 
-  for(uint i = get_global_id(0); i < n; i += stride)
+  for(; i < e; ++i)
     c[i] = a[i] + b[i];
 }
 
-kernel void gpu_triad(global double * restrict a,
-                      global double * restrict b,
-                      global double * restrict c,
-                      double k,
-                      uint n)
+kernel void cpu_triad(global ELEMENT * restrict a,
+                      global ELEMENT * restrict b,
+                      global ELEMENT * restrict c,
+                      ELEMENT k,
+                      ulong n)
 {
-  uint stride = get_global_size(0);
+  ulong i, l, e;
+  cpu_chunk(n, &i, &l, &e);
 
-  for(uint i = get_global_id(0); i < n; i += stride)
+  for(; i < l; i += VECTOR_WIDTH)
+    VSTORE(VLOAD(0, b + i) + k * VLOAD(0, c + i), 0, a + i);
+
+  for(; i < e; ++i)
     a[i] = b[i] + k * c[i];
 }
+
+kernel void cpu_dot(global const ELEMENT * restrict a,
+                    global const ELEMENT * restrict b,
+                    global ELEMENT * restrict sums,
+                    ulong n)
+{
+  ulong i, l, e;
+  cpu_chunk(n, &i, &l, &e);
+
+  VECTOR acc = (VECTOR)(0);
+  ELEMENT sum = 0;
+
+  for(; i < l; i += VECTOR_WIDTH)
+    acc += VLOAD(0, a + i) * VLOAD(0, b + i);
+
+  for(; i < e; ++i)
+    sum += a[i] * b[i];
+
+  // Add up the lanes of the accumulator.
+  ELEMENT lanes[VECTOR_WIDTH];
+  VSTORE(acc, 0, lanes);
+
+  for(uint j = 0; j < VECTOR_WIDTH; ++j)
+    sum += lanes[j];
+
+  // One partial sum for each work item, reduced by the host.
+  sums[get_global_id(0)] = sum;
+}
+
+kernel void cpu_fill(global ELEMENT * restrict c,
+                     ELEMENT k,
+                     ulong n)
+{
+  ulong i, l, e;
+  cpu_chunk(n, &i, &l, &e);
+
+  VECTOR kv = (VECTOR)(k);
+
+  for(; i < l; i += VECTOR_WIDTH)
+    VSTORE(kv, 0, c + i);
+
+  for(; i < e; ++i)
+    c[i] = k;
+}
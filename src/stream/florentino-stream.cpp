@@ -1,17 +1,43 @@
 
 #include "cpu-stream.h"
+#include "numa-stream.h"
 #include "ocl-stream.h"
 
 using namespace florentino;
 
-int main(int argc, char *argv[]) {
-  StreamBenchmarkRunner runner(argc, argv);
+namespace {
+
+// Add all the benchmarks working on arrays of Ty elements. They are run only
+// if that type has been requested.
+template <typename Ty>
+void addBenchmarks(StreamBenchmarkRunner &runner) {
+  runner.add(new CPUStream<Ty>(runner));
+  runner.add(new CPUStream<Ty>(runner, true));
 
-  runner.add(new CPUStream(runner));
+#ifdef HAVE_NUMA
+  std::vector<int> memNodes = NUMANodes::memoryNodes(),
+                   cpuNodes = NUMANodes::cpuNodes();
+
+  for(unsigned i = 0, e = memNodes.size(); i != e; ++i)
+    for(unsigned j = 0, f = cpuNodes.size(); j != f; ++j)
+      runner.add(new NUMACPUStream<Ty>(runner, memNodes[i], cpuNodes[j]));
+#endif
 
 #ifdef HAVE_OPENCL
-  runner.add(new OpenCLGPUStream(runner));
+  runner.add(new OpenCLGPUStream<Ty>(runner));
+  runner.add(new OpenCLCPUStream<Ty>(runner));
 #endif
+}
+
+} // End anonymous namespace.
+
+int main(int argc, char *argv[]) {
+  StreamBenchmarkRunner runner(argc, argv);
+
+  addBenchmarks<double>(runner);
+  addBenchmarks<float>(runner);
+  addBenchmarks<Int32>(runner);
+  addBenchmarks<Int64>(runner);
 
   return runner.run();
 }
@@ -0,0 +1,116 @@
+
+#include "numa-stream.h"
+
+#ifdef HAVE_NUMA
+
+#include "florentino/memory.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include <numa.h>
+
+using namespace florentino;
+
+namespace {
+
+std::string buildName(int memNode, int cpuNode) {
+  std::ostringstream os;
+  os << "CPU-STREAM-NUMA-M" << memNode << "-C" << cpuNode;
+
+  return os.str();
+}
+
+} // End anonymous namespace.
+
+//
+// NUMANodes implementation.
+//
+
+std::vector<int> NUMANodes::memoryNodes() {
+  std::vector<int> nodes;
+
+  if(numa_available() == -1)
+    return nodes;
+
+  for(int i = 0, e = numa_max_node() + 1; i != e; ++i)
+    if(numa_bitmask_isbitset(numa_all_nodes_ptr, i))
+      nodes.push_back(i);
+
+  return nodes;
+}
+
+std::vector<int> NUMANodes::cpuNodes() {
+  std::vector<int> nodes;
+
+  if(numa_available() == -1)
+    return nodes;
+
+  for(int i = 0, e = numa_max_node() + 1; i != e; ++i)
+    if(!nodeCPUs(i).empty())
+      nodes.push_back(i);
+
+  return nodes;
+}
+
+std::vector<unsigned> NUMANodes::nodeCPUs(int node) {
+  std::vector<unsigned> available = ThreadTeam::availableCPUs(),
+                        cpus;
+
+  bitmask *mask = numa_allocate_cpumask();
+
+  // Only consider CPUs this process can run on.
+  if(!numa_node_to_cpus(node, mask))
+    for(unsigned i = 0, e = available.size(); i != e; ++i)
+      if(numa_bitmask_isbitset(mask, available[i]))
+        cpus.push_back(available[i]);
+
+  numa_free_cpumask(mask);
+
+  return cpus;
+}
+
+//
+// NUMACPUStream implementation.
+//
+
+template <typename Ty>
+NUMACPUStream<Ty>::NUMACPUStream(StreamBenchmarkRunner &runner,
+                                 int memNode,
+                                 int cpuNode)
+  : CPUStream<Ty>(buildName(memNode, cpuNode), runner),
+    _memNode(memNode),
+    _cpuNode(cpuNode) { }
+
+template <typename Ty>
+void NUMACPUStream<Ty>::setup() {
+  CPUStream<Ty>::setup();
+
+  this->parameter("memory-node", _memNode);
+  this->parameter("cpu-node", _cpuNode);
+}
+
+template <typename Ty>
+Ty *NUMACPUStream<Ty>::allocArray(size_t length) {
+  // Pages are bound to the node, no matter which thread touches them first.
+  return xpalloc<Ty>(length, this->pagePolicy(), _memNode);
+}
+
+template <typename Ty>
+void NUMACPUStream<Ty>::freeArray(Ty *arr, size_t length) {
+  xpfree(arr, length, this->pagePolicy());
+}
+
+template <typename Ty>
+std::vector<unsigned> NUMACPUStream<Ty>::teamCPUs() {
+  return ThreadTeam::spread(NUMANodes::nodeCPUs(_cpuNode),
+                            this->threadsCount());
+}
+
+// Benchmarks are built for all the supported element types.
+template class florentino::NUMACPUStream<float>;
+template class florentino::NUMACPUStream<double>;
+template class florentino::NUMACPUStream<Int32>;
+template class florentino::NUMACPUStream<Int64>;
+
+#endif // HAVE_NUMA
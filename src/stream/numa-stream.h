@@ -0,0 +1,59 @@
+
+#ifndef NUMA_STREAM_H
+#define NUMA_STREAM_H
+
+#ifdef HAVE_NUMA
+
+#include "cpu-stream.h"
+
+namespace florentino {
+
+// The NUMA nodes of the system, as seen by this process.
+class NUMANodes {
+public:
+  // Nodes with memory, and nodes with CPUs this process can run on.
+  static std::vector<int> memoryNodes();
+  static std::vector<int> cpuNodes();
+
+  // The CPUs of the given node this process can run on.
+  static std::vector<unsigned> nodeCPUs(int node);
+};
+
+// Execute STREAM on the CPU, binding arrays to a NUMA node and threads to the
+// CPUs of another -- possibly the same -- node. Running this benchmark for all
+// pairs of nodes gives the local/remote bandwidth matrix of the system.
+template <typename Ty>
+class NUMACPUStream : public CPUStream<Ty> {
+public:
+  NUMACPUStream(StreamBenchmarkRunner &runner, int memNode, int cpuNode);
+
+public:
+  virtual void setup();
+
+public:
+  virtual bool enabled() const {
+    StreamBenchmarkRunner &runner =
+      Benchmark::runner<StreamBenchmarkRunner>();
+    return StreamBench::enabled() && runner.numa();
+  }
+
+public:
+  int memoryNode() const { return _memNode; }
+  int cpuNode() const { return _cpuNode; }
+
+protected:
+  virtual Ty *allocArray(size_t length);
+  virtual void freeArray(Ty *arr, size_t length);
+
+  virtual std::vector<unsigned> teamCPUs();
+
+private:
+  int _memNode;
+  int _cpuNode;
+};
+
+} // End namespace florentino.
+
+#endif // HAVE_NUMA
+
+#endif // NUMA_STREAM_H
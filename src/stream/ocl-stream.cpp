@@ -1,12 +1,51 @@
 
 #include "ocl-stream.h"
 
+#include "florentino/statistics.h"
+#include "florentino/thread.h"
+
+#include <algorithm>
+#include <fstream>
 #include <iomanip>
+#include <limits>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
 
 #ifdef HAVE_OPENCL
 
 using namespace florentino;
 
+namespace {
+
+// Widths of the vector variants of the GPU kernels.
+const unsigned TUNING_WIDTHS[] = { 1, 2, 4, 8 };
+const unsigned TUNING_WIDTHS_COUNT
+  = sizeof(TUNING_WIDTHS) / sizeof(*TUNING_WIDTHS);
+
+// Sizes of work groups tried by the autotuner, as multiples of the preferred
+// one. Widths are compared on work groups of the default size, the same used by
+// OpenCLStream::iterationSpace.
+const size_t TUNING_GROUP_MULTIPLES[] = { 1, 2, 4, 8, 16 };
+const unsigned TUNING_GROUP_MULTIPLES_COUNT
+  = sizeof(TUNING_GROUP_MULTIPLES) / sizeof(*TUNING_GROUP_MULTIPLES);
+const size_t TUNING_DEFAULT_GROUP_MULTIPLE = 4;
+
+// Vectors processed by each work item, tried by the autotuner.
+const size_t TUNING_ITEM_VECTORS[] = { 1, 2, 4, 8, 16, 32 };
+const unsigned TUNING_ITEM_VECTORS_COUNT
+  = sizeof(TUNING_ITEM_VECTORS) / sizeof(*TUNING_ITEM_VECTORS);
+
+// Timed launches of each configuration: the fastest counts.
+const unsigned TUNING_RUNS = 3;
+
+// Elements copied by each device to measure its bandwidth, before splitting
+// arrays among devices, and timed launches of the copy: the fastest counts.
+const size_t PROBE_LENGTH = size_t(4) << 20;
+const unsigned PROBE_RUNS = 3;
+
+} // End anonymous namespace.
+
 //
 // OCLStream implementation.
 //
@@ -14,110 +53,171 @@ using namespace florentino;
 void OpenCLStream::setup() {
   _envs.resize(devsCount());
 
-  size_t chunkLength = arrayLength() / devsCount();
-
   // Request superclass to find all devices we need.
   allocDevices(_devType, devsCount());
 
-  // Stores information about WIs to be printed before execution.
-  #define KERNEL(N)                                                 \
-  std::vector<std::pair<size_t, size_t> > N ## Spaces(devsCount());
+  for(unsigned i = 0, e = devsCount(); i != e; ++i)
+    _envs[i].queue(allocQueue(i));
 
-  KERNEL(init)
-  KERNEL(copy)
-  KERNEL(scale)
-  KERNEL(add)
-  KERNEL(triad)
+  // Compile the program for the element type. Double precision is an optional
+  // OpenCL extension: kernels check it is available.
+  std::ostringstream options;
+  options << "-DELEMENT=" << _openCLType
+          << " -DVECTOR_WIDTH=" << vectorWidth();
 
-  #undef KERNEL
+  if(std::string(_openCLType) == "double")
+    options << " -DELEMENT_FP64";
+
+  compile(dataDir(), "florentino-stream-kernels.cl", options.str(), cacheDir());
 
-  // Allocate needed resources.
+  // Probing devices needs kernels, and decides the size of buffers.
+  partition();
+
+  // Allocate needed resources. Buffers cannot be empty, even if the device
+  // does not get any element.
   for(unsigned i = 0, e = devsCount(); i != e; ++i) {
     Environment &env = _envs[i];
-    size_t myChunkLength = chunkLength;
-
-    // Extra elements processed by the last device.
-    if(i == e - 1)
-      myChunkLength += arrayLength() % devsCount();
+    size_t size = std::max<size_t>(chunkLength(i), 1) * elementBytes();
 
-    #define BUFFER(N)                                   \
-    env.N(allocBuffer(myChunkLength * sizeof(double)));
+    #define BUFFER(N)            \
+    env.N(allocBuffer(size, i));
 
     BUFFER(a)
     BUFFER(b)
     BUFFER(c)
 
     #undef BUFFER
-
-    env.queue(allocQueue(i));
   }
 
-  // Compile the program.
-  compile(dataDir(), "florentino-stream-kernels.cl");
-
-  // Load kernels.
-  cl::Kernel init = loadInit(),
-             copy = loadCopy(),
-             scale = loadScale(),
-             add = loadAdd(),
-             triad = loadTriad();
-
-  // Setup iteration spaces.
+  // Load kernels, and setup iteration spaces. Devices of different platforms
+  // use different programs, so kernels are loaded for each device.
   for(unsigned i = 0, e = devsCount(); i != e; ++i) {
     Environment &env = _envs[i];
-    size_t myChunkLength = chunkLength;
-
     size_t globalWI, localWI;
 
-    // Last device should handles extra elements.
-    if(i == e - 1)
-      myChunkLength += arrayLength() % devsCount();
-
-    #define KERNEL(N)                                                         \
-    /* Initial attempt to map the iteration space on the device. */           \
-    globalWI = myChunkLength;                                                 \
-    localWI = 4 * preferredWGSizeMultiple(N, i);                              \
-                                                                              \
-    /* Number of local work items must always be lesser or equal to number */ \
-    /* of global work items. */                                               \
-    if(globalWI < localWI)                                                    \
-      globalWI = localWI;                                                     \
-                                                                              \
-    /* Make sure number of global work items is a multiple of number of */    \
-    /* local work items. */                                                   \
-    if(size_t rem = globalWI % localWI)                                       \
-      globalWI += localWI - rem;                                              \
-                                                                              \
-    /* Iter space should be printer later */                                  \
-    N ## Spaces[i] = std::make_pair(globalWI, localWI);                       \
-                                                                              \
-    /* Bind kernel to iteration space. */                                     \
+    #define KERNEL(N, L)                                       \
+    cl::Kernel N = load ## L(i);                               \
+    iterationSpace(N, i, chunkLength(i), globalWI, localWI);   \
+                                                               \
+    /* Bind kernel to iteration space. */                      \
     env.N(N, globalWI, localWI);
 
-    KERNEL(init)
-    KERNEL(copy)
-    KERNEL(scale)
-    KERNEL(add)
-    KERNEL(triad)
+    KERNEL(init, Init)
+    KERNEL(copy, Copy)
+    KERNEL(scale, Scale)
+    KERNEL(add, Add)
+    KERNEL(triad, Triad)
+    KERNEL(dot, Dot)
+    KERNEL(fill, Fill)
 
     #undef KERNEL
+
+    env.sums(allocBuffer(env.dotPartials() * elementBytes(), i));
   }
 
+  // Tuning streams arrays, so it must precede initialization.
+  _tunings.clear();
+  if(autotune())
+    tune(options.str());
+
   // Now, there is a working OpenCL environment.
   StreamBench::setup();
 
+  parameter("devices", devsCount());
+
+  static const char *cacheStates[] = { "disabled", "hit", "miss" };
+
+  parameter("program-cache", cacheStates[programCache()]);
+  metric("compile-time-s", compileTime());
+
+  log() << "Program cache = " << cacheStates[programCache()]
+        << ", compile time = " << compileTime() << " s"
+        << std::endl;
+
+  std::ostringstream lengths;
+
+  for(unsigned i = 0, e = devsCount(); i != e; ++i)
+    lengths << (i ? "," : "") << chunkLength(i);
+
+  parameter("partition", lengths.str());
+
+  log() << "Partition among devices:"
+        << std::endl;
+
+  for(unsigned i = 0, e = devsCount(); i != e; ++i) {
+    std::ostringstream name;
+    name << "device-" << i << "-probe-rate-MBps";
+
+    if(devsCount() > 1)
+      metric(name.str(), _probeRates[i]);
+
+    log() << std::setw(16) << i << ": "
+          << chunkLength(i) << " elements from " << chunkOffset(i)
+          << ", " << deviceName(i);
+
+    if(devsCount() > 1)
+      log() << ", probed at "
+            << std::fixed << std::setprecision(1) << _probeRates[i]
+            << " MB/s";
+
+    log() << std::endl;
+  }
+
+  if(!autotune())
+    parameter("autotune", "off");
+  else if(_tunings.empty())
+    parameter("autotune", "unsupported");
+  else {
+    static const char *tunings[] = { "cached", "searched" };
+
+    std::string tuned;
+    for(unsigned i = 0, e = devsCount(); i != e; ++i)
+      tuned += (i ? "," : "") + std::string(tunings[_tunings[i]]);
+
+    parameter("autotune", tuned);
+
+    // Each kernel is configured as width:local WI:vectors per WI on each
+    // device.
+    log() << "Autotuned configurations (width:local:vectors per item):"
+          << std::endl;
+
+    for(unsigned i = 0, e = KernelsCount; i != e; ++i) {
+      std::ostringstream configs;
+
+      for(unsigned j = 0, f = devsCount(); j != f; ++j) {
+        const KernelConfig &config = _configs[j][i];
+
+        configs << (j ? "," : "")
+                << config.width() << ":"
+                << config.localWI() << ":"
+                << config.itemVectors();
+      }
+
+      parameter(kernelTag(Kernel(i)) + "-config", configs.str());
+
+      log() << std::setw(18) << (kernelTag(Kernel(i)) + ": ")
+            << configs.str()
+            << std::endl;
+    }
+
+    log() << std::setw(18) << "devices: " << tuned
+          << std::endl;
+  }
+
   log() << "Iteration spaces:"
         << std::endl;
 
-  #define KERNEL(N)                                 \
-  log() << std::setw(18)                            \
-        << # N ": ";                                \
-                                                    \
-  for(unsigned i = 0, e = devsCount(); i != e; ++i) \
-    log() << "(" << N ## Spaces[i].first << ","     \
-                 << N ## Spaces[i].second           \
-          << ")";                                   \
-                                                    \
+  #define KERNEL(N)                                                   \
+  log() << std::setw(18)                                              \
+        << # N ": ";                                                  \
+                                                                      \
+  for(unsigned i = 0, e = devsCount(); i != e; ++i)                   \
+    log() << "(" << _envs[i].N ## GlobalWI()[0] << ","                \
+                 << (_envs[i].N ## LocalWI().dimensions()             \
+                     ? _envs[i].N ## LocalWI()[0]                     \
+                     : 0)                                             \
+          << ")";                                                     \
+                                                                      \
   log() << std::endl;
 
   KERNEL(init)
@@ -125,16 +225,64 @@ void OpenCLStream::setup() {
   KERNEL(scale)
   KERNEL(add)
   KERNEL(triad)
+  KERNEL(dot)
+  KERNEL(fill)
 
   #undef KERNEL
 
   log() << hline;
 }
 
+void OpenCLStream::run() {
+  std::fill(_deviceTimes, _deviceTimes + KernelsCount, 0);
+
+  StreamBench::run();
+
+  _clocks.record(ClkDevice, 0);
+
+  for(unsigned i = 0, e = KernelsCount; i != e; ++i) {
+    double seconds = _deviceTimes[i] * 1e-9;
+
+    _clocks.record(ClkDeviceCopy + i, seconds / ClockSource::period());
+  }
+}
+
 void OpenCLStream::teardown() {
   // Do superclass work.
   StreamBench::teardown();
 
+  // Host times include enqueueing, launching, and waiting for the kernels.
+  log() << "Function    Host min time  Device min time  Device rate MB/s"
+        << "  Overhead"
+        << std::endl;
+
+  for(unsigned i = 0, e = KernelsCount; i != e; ++i) {
+    Kernel kernel = Kernel(i);
+
+    Statistics host = kernelStatistics(kernel),
+               device(_clocks[ClkDeviceCopy + i], _clocks[ClkDevice], warmup());
+
+    size_t totalSize = kernelBytes(kernel) * arrayLength() * passes();
+    double rate = totalSize * 1e-6 / device.min(),
+           overhead = (host.min() - device.min()) / host.min();
+
+    metric(kernelTag(kernel) + "-device-best-rate-MBps", rate);
+    metric(kernelTag(kernel) + "-launch-overhead", overhead);
+
+    log() << std::left << std::setw(12)
+          << (std::string(kernelName(kernel)) + ":")
+          << std::right
+          << std::fixed << std::setprecision(6)
+          << std::setw(13) << host.min()
+          << "  " << std::setw(15) << device.min()
+          << std::fixed << std::setprecision(1)
+          << "  " << std::setw(16) << rate
+          << "  " << std::setw(7) << 100 * overhead << "%"
+          << std::endl;
+  }
+
+  log() << hline;
+
   // Detach all resources.
   for(unsigned i = 0, e = devsCount(); i != e; ++i)
     _envs[i].clear();
@@ -143,32 +291,50 @@ void OpenCLStream::teardown() {
   clearDevices();
 }
 
-void OpenCLStream::check(double k) {
-  std::vector<double> a(arrayLength()),
-                      b(arrayLength()),
-                      c(arrayLength());
+void OpenCLStream::iterationSpace(cl::Kernel &kernel,
+                                  unsigned dev,
+                                  size_t length,
+                                  size_t &globalWI,
+                                  size_t &localWI) {
+  // Initial attempt to map the iteration space on the device.
+  globalWI = length;
+  localWI = 4 * preferredWGSizeMultiple(kernel, dev);
+
+  // Number of local work items must always be lesser or equal to number of
+  // global work items.
+  if(globalWI < localWI)
+    globalWI = localWI;
+
+  // Make sure number of global work items is a multiple of number of local
+  // work items.
+  if(size_t rem = globalWI % localWI)
+    globalWI += localWI - rem;
+}
 
-  size_t chunkLength = arrayLength() / devsCount(),
-         chunkSize = chunkLength * sizeof(double);
+template <typename Ty>
+void OpenCLStream::readArrays(std::vector<Ty> &a,
+                              std::vector<Ty> &b,
+                              std::vector<Ty> &c) {
+  a.resize(arrayLength());
+  b.resize(arrayLength());
+  c.resize(arrayLength());
 
   // Read buffers into temp arrays.
   for(unsigned i = 0, e = devsCount(); i != e; ++i) {
-    size_t myChunkLength = chunkLength,
-           myChunkSize;
+    size_t myChunkSize = chunkLength(i) * sizeof(Ty),
+           myChunkOffset = chunkOffset(i);
 
-    if(i == e - 1)
-      myChunkLength += chunkLength % devsCount();
-
-    myChunkSize = myChunkLength * sizeof(double);
+    if(!myChunkSize)
+      continue;
 
     cl::CommandQueue &queue = _envs[i].queue();
 
-    #define BUFFER(N)                            \
-    queue.enqueueReadBuffer(_envs[i].N(),        \
-                            false,               \
-                            0,                   \
-                            myChunkSize,         \
-                            &N[i * chunkLength]);
+    #define BUFFER(N)                               \
+    queue.enqueueReadBuffer(_envs[i].N(),           \
+                            false,                  \
+                            0,                      \
+                            myChunkSize,            \
+                            &N[myChunkOffset]);
 
     BUFFER(a)
     BUFFER(b)
@@ -182,23 +348,448 @@ void OpenCLStream::check(double k) {
     cl::CommandQueue &queue = _envs[i].queue();
     queue.finish();
   }
+}
+
+void OpenCLStream::profile(Kernel kernel) {
+  cl_ulong longest = 0;
+
+  for(unsigned i = 0, e = devsCount(); i != e; ++i)
+    longest = std::max(longest, deviceTime(i));
+
+  _deviceTimes[kernel] += longest;
+}
+
+void OpenCLStream::reserveDeviceClocks() {
+  _clocks.reserve(ClkDevice, "device");
+
+  for(unsigned i = 0, e = KernelsCount; i != e; ++i) {
+    std::string name = kernelTag(Kernel(i)) + "-device";
+
+    _clocks.reserve(ClkDeviceCopy + i, name);
+    interval(name, ClkDevice, ClkDeviceCopy + i);
+  }
+
+  std::fill(_deviceTimes, _deviceTimes + KernelsCount, 0);
+}
+
+void OpenCLStream::partition() {
+  unsigned devs = devsCount();
+
+  std::vector<double> weights(devs, 1.0);
+  _probeRates.assign(devs, 0.0);
+
+  if(devs > 1) {
+    size_t length = std::min(PROBE_LENGTH, arrayLength()),
+           size = std::max<size_t>(length, 1) * elementBytes();
+
+    // Devices are probed one at a time, each with the default iteration space
+    // of its copy kernel.
+    for(unsigned i = 0; i != devs; ++i) {
+      cl::CommandQueue &queue = _envs[i].queue();
+      cl::Kernel copy = loadCopy(i);
+      cl::Buffer a = allocBuffer(size, i),
+                 c = allocBuffer(size, i);
+
+      size_t globalWI, localWI;
+      iterationSpace(copy, i, length, globalWI, localWI);
+
+      copy.setArg(0, a);
+      copy.setArg(1, c);
+      copy.setArg(2, cl_ulong(length));
+
+      cl_ulong best = std::numeric_limits<cl_ulong>::max();
+
+      // The first launch maps buffers on the device: do not time it.
+      for(unsigned r = 0; r != PROBE_RUNS + 1; ++r) {
+        cl::Event event;
+
+        queue.enqueueNDRangeKernel(copy,
+                                   cl::NullRange,
+                                   cl::NDRange(globalWI),
+                                   localWI ? cl::NDRange(localWI)
+                                           : cl::NullRange,
+                                   0,
+                                   &event);
+        event.wait();
+
+        cl_ulong start = event.getProfilingInfo<CL_PROFILING_COMMAND_START>(),
+                 end = event.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+
+        if(r)
+          best = std::min(best, end - start);
+      }
+
+      // Bytes per nanosecond are GB/s.
+      weights[i] = 2.0 * length * elementBytes() / std::max<cl_ulong>(best, 1);
+      _probeRates[i] = weights[i] * 1e3;
+    }
+  }
+
+  double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+
+  _chunkLengths.assign(devs, 0);
+  _chunkOffsets.assign(devs, 0);
+
+  // Chunks start on cache line boundaries, as vector kernels expect. The last
+  // device gets the elements left by rounding.
+  size_t granule = vectorWidth(),
+         offset = 0;
+
+  for(unsigned i = 0; i != devs; ++i) {
+    size_t length = arrayLength() - offset;
+
+    if(i != devs - 1)
+      length = std::min(length,
+                        size_t(arrayLength() * (weights[i] / total)) /
+                        granule * granule);
+
+    _chunkLengths[i] = length;
+    _chunkOffsets[i] = offset;
+
+    offset += length;
+  }
+}
+
+cl_ulong OpenCLStream::deviceTime(unsigned dev) {
+  cl::Event &event = _envs[dev].event();
+
+  cl_ulong start = event.getProfilingInfo<CL_PROFILING_COMMAND_START>(),
+           end = event.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+
+  return end - start;
+}
+
+cl::Kernel OpenCLStream::loadVariant(Kernel, unsigned, unsigned) {
+  throw std::logic_error("kernel variants not available");
+}
+
+void OpenCLStream::tune(const std::string &options) {
+  std::vector<unsigned> widths = vectorWidths();
+  unsigned devs = devsCount();
+
+  if(widths.empty())
+    return;
+
+  std::vector<std::vector<KernelVariants> >
+    variants(devs, std::vector<KernelVariants>(KernelsCount));
+
+  for(unsigned i = 0; i != devs; ++i)
+    for(unsigned j = 0, e = KernelsCount; j != e; ++j)
+      for(unsigned k = 0, f = widths.size(); k != f; ++k)
+        variants[i][j][widths[k]] = loadVariant(Kernel(j), widths[k], i);
+
+  _configs.assign(devs, std::vector<KernelConfig>(KernelsCount));
+  _tunings.assign(devs, TuningSearched);
+
+  bool searching = false;
+
+  for(unsigned i = 0; i != devs; ++i) {
+    if(!cacheDir().empty() &&
+       loadTuning(i, tuningPath(i, options), variants[i]))
+      _tunings[i] = TuningCached;
+    else
+      searching = true;
+  }
+
+  if(searching) {
+    // Time kernels on initialized arrays, with pages already mapped.
+    init();
+
+    for(unsigned i = 0, e = KernelsCount; i != e; ++i) {
+      Kernel kernel = Kernel(i);
+      std::vector<std::vector<KernelConfig> > candidates(devs);
+
+      // Coordinate search: first pick the width, then the size of work groups,
+      // and last the work done by each work item, keeping the others fixed.
+      for(unsigned j = 0; j != devs; ++j)
+        if(_tunings[j] == TuningSearched)
+          for(unsigned k = 0, f = widths.size(); k != f; ++k) {
+            cl::Kernel &kern = variants[j][i][widths[k]];
+            size_t localWI = std::min(TUNING_DEFAULT_GROUP_MULTIPLE *
+                                        preferredWGSizeMultiple(kern, j),
+                                      maxWGSize(kern, j));
+
+            candidates[j].push_back(KernelConfig(widths[k], localWI));
+          }
+
+      search(kernel, variants, candidates);
+
+      for(unsigned j = 0; j != devs; ++j) {
+        if(_tunings[j] != TuningSearched)
+          continue;
+
+        const KernelConfig &best = _configs[j][i];
+        cl::Kernel &kern = variants[j][i][best.width()];
+
+        size_t multiple = preferredWGSizeMultiple(kern, j),
+               maxLocalWI = maxWGSize(kern, j);
+
+        candidates[j].clear();
+
+        for(unsigned k = 0; k != TUNING_GROUP_MULTIPLES_COUNT; ++k)
+          if(multiple * TUNING_GROUP_MULTIPLES[k] <= maxLocalWI)
+            candidates[j].push_back(
+              KernelConfig(best.width(), multiple * TUNING_GROUP_MULTIPLES[k]));
+      }
+
+      search(kernel, variants, candidates);
+
+      for(unsigned j = 0; j != devs; ++j) {
+        if(_tunings[j] != TuningSearched)
+          continue;
+
+        const KernelConfig best = _configs[j][i];
+
+        candidates[j].clear();
+
+        for(unsigned k = 0; k != TUNING_ITEM_VECTORS_COUNT; ++k)
+          candidates[j].push_back(KernelConfig(best.width(),
+                                               best.localWI(),
+                                               TUNING_ITEM_VECTORS[k]));
+      }
+
+      search(kernel, variants, candidates);
+    }
+
+    // Timing kernels accounted device times: they are not part of any run.
+    std::fill(_deviceTimes, _deviceTimes + KernelsCount, 0);
+  }
+
+  // Bind the selected configurations, and save the new ones.
+  for(unsigned i = 0; i != devs; ++i) {
+    for(unsigned j = 0, e = KernelsCount; j != e; ++j) {
+      const KernelConfig &config = _configs[i][j];
+
+      bind(Kernel(j), i, variants[i][j][config.width()], config);
+    }
+
+    if(_tunings[i] == TuningSearched && !cacheDir().empty())
+      storeTuning(i, tuningPath(i, options));
+  }
+}
+
+void OpenCLStream::search(
+       Kernel kernel,
+       std::vector<std::vector<KernelVariants> > &variants,
+       const std::vector<std::vector<KernelConfig> > &candidates) {
+  unsigned devs = devsCount();
+  size_t trials = 0;
+
+  for(unsigned i = 0; i != devs; ++i)
+    trials = std::max(trials, candidates[i].size());
+
+  std::vector<cl_ulong> best(devs, std::numeric_limits<cl_ulong>::max());
+
+  for(size_t i = 0; i != trials; ++i) {
+    // Devices with fewer candidates repeat their last one.
+    for(unsigned j = 0; j != devs; ++j) {
+      const KernelConfig &config =
+        candidates[j].empty()
+        ? _configs[j][kernel]
+        : candidates[j][std::min(i, candidates[j].size() - 1)];
+
+      bind(kernel, j, variants[j][kernel][config.width()], config);
+    }
+
+    std::vector<cl_ulong> times(devs, std::numeric_limits<cl_ulong>::max());
+
+    // The first launch is not timed, as some runtimes lazily finalize kernels.
+    runKernel(kernel);
+
+    for(unsigned r = 0; r != TUNING_RUNS; ++r) {
+      runKernel(kernel);
+
+      for(unsigned j = 0; j != devs; ++j)
+        times[j] = std::min(times[j], deviceTime(j));
+    }
+
+    for(unsigned j = 0; j != devs; ++j)
+      if(i < candidates[j].size() && times[j] < best[j]) {
+        best[j] = times[j];
+        _configs[j][kernel] = candidates[j][i];
+      }
+  }
+}
+
+void OpenCLStream::bind(Kernel kernel,
+                        unsigned dev,
+                        cl::Kernel &kern,
+                        const KernelConfig &config) {
+  Environment &env = _envs[dev];
+  size_t globalWI, localWI;
+
+  config.iterationSpace(chunkLength(dev), globalWI, localWI);
+
+  switch(kernel) {
+  case Copy:
+    env.copy(kern, globalWI, localWI);
+    break;
+  case Scale:
+    env.scale(kern, globalWI, localWI);
+    break;
+  case Add:
+    env.add(kern, globalWI, localWI);
+    break;
+  case Triad:
+    env.triad(kern, globalWI, localWI);
+    break;
+  case Dot:
+    env.dot(kern, globalWI, localWI);
+    env.sums(allocBuffer(env.dotPartials() * elementBytes(), dev));
+    break;
+  case Fill:
+    env.fill(kern, globalWI, localWI);
+    break;
+  default:
+    break;
+  }
+}
+
+std::string OpenCLStream::tuningPath(unsigned dev,
+                                     const std::string &options) {
+  // Iteration spaces depend on the length of arrays on the device. It changes
+  // slightly from run to run, as devices are probed each time: use the length
+  // of the arrays and the number of devices instead.
+  std::ostringstream key;
+  key << "autotune" << '\0'
+      << options << '\0'
+      << arrayLength() << '\0'
+      << devsCount() << '\0'
+      << dev;
+
+  return cachePath(cacheDir(), key.str(), dev, ".tune");
+}
+
+bool OpenCLStream::loadTuning(unsigned dev,
+                              const std::string &path,
+                              std::vector<KernelVariants> &variants) {
+  std::ifstream is(path.c_str());
+
+  if(!is)
+    return false;
+
+  std::vector<KernelConfig> configs(KernelsCount);
+  std::vector<bool> loaded(KernelsCount, false);
+
+  std::string tag;
+  unsigned width;
+  size_t localWI, itemVectors;
+
+  // A line for each kernel: tag, width, local WI, vectors per WI.
+  while(is >> tag >> width >> localWI >> itemVectors) {
+    unsigned i = 0, e = KernelsCount;
+
+    while(i != e && kernelTag(Kernel(i)) != tag)
+      ++i;
+
+    // Saved by another version of the benchmark: tune again.
+    if(i == e || !variants[i].count(width) || !localWI || !itemVectors)
+      return false;
+
+    if(localWI > maxWGSize(variants[i][width], dev))
+      return false;
+
+    configs[i] = KernelConfig(width, localWI, itemVectors);
+    loaded[i] = true;
+  }
+
+  if(std::count(loaded.begin(), loaded.end(), false))
+    return false;
+
+  _configs[dev] = configs;
+
+  return true;
+}
+
+void OpenCLStream::storeTuning(unsigned dev, const std::string &path) {
+  std::ostringstream os;
+
+  for(unsigned i = 0, e = KernelsCount; i != e; ++i) {
+    const KernelConfig &config = _configs[dev][i];
+
+    os << kernelTag(Kernel(i)) << " "
+       << config.width() << " "
+       << config.localWI() << " "
+       << config.itemVectors() << std::endl;
+  }
+
+  std::string data = os.str();
+
+  storeCacheFile(cacheDir(), path, data.data(), data.size());
+}
+
+void OpenCLStream::wait() {
+  // Flush all queues just to be sure commands are moved to devices, then wait
+  // for termination.
+
+  for(unsigned i = 0, e = devsCount(); i != e; ++i) {
+    cl::CommandQueue &queue = _envs[i].queue();
+    queue.flush();
+  }
+
+  for(unsigned i = 0, e = devsCount(); i != e; ++i) {
+    cl::CommandQueue &queue = _envs[i].queue();
+    queue.finish();
+  }
+}
 
-  // Do the check in the host.
-  StreamBench::check(&a[0], &b[0], &c[0], k);
+//
+// OpenCLStream::KernelConfig implementation.
+//
+
+void OpenCLStream::KernelConfig::iterationSpace(size_t length,
+                                                size_t &globalWI,
+                                                size_t &localWI) const {
+  size_t vectors = (length + _width - 1) / _width,
+         items = (vectors + _itemVectors - 1) / _itemVectors;
+
+  localWI = _localWI;
+
+  // At least a work group, and whole work groups.
+  globalWI = std::max(localWI, (items + localWI - 1) / localWI * localWI);
 }
 
 //
-// OpenCLGPUStream implementation.
+// OpenCLTypedStream implementation.
 //
 
-void OpenCLGPUStream::init() {
-  size_t chunkLength = arrayLength() / devsCount();
+template <typename Ty>
+void OpenCLTypedStream<Ty>::check(double k) {
+  std::vector<Ty> a, b, c;
+  readArrays(a, b, c);
+
+  // Do the check in the host, using all the CPUs.
+  ThreadTeam team(ThreadTeam::availableCPUs());
+  StreamBench::check(&a[0], &b[0], &c[0], Ty(k), dotResult(), team);
+}
+
+template <typename Ty>
+typename OpenCLTypedStream<Ty>::Accumulator
+OpenCLTypedStream<Ty>::dotResult() {
+  // Partial sums of work groups are few: reduce them on the host.
+  Accumulator sum = 0;
 
   for(unsigned i = 0, e = devsCount(); i != e; ++i) {
-    size_t myChunkLength = chunkLength;
+    size_t groups = _envs[i].dotPartials();
+    std::vector<Ty> sums(groups);
+
+    _envs[i].queue().enqueueReadBuffer(_envs[i].sums(),
+                                       true,
+                                       0,
+                                       groups * sizeof(Ty),
+                                       &sums[0]);
+
+    for(unsigned j = 0; j != groups; ++j)
+      sum += sums[j];
+  }
 
-    if(i == e - 1)
-      myChunkLength += arrayLength() % devsCount();
+  return sum;
+}
+
+template <typename Ty>
+void OpenCLTypedStream<Ty>::init() {
+  for(unsigned i = 0, e = devsCount(); i != e; ++i) {
+    size_t myChunkLength = chunkLength(i);
 
     cl::CommandQueue &queue = _envs[i].queue();
     cl::Kernel &init = _envs[i].init();
@@ -206,7 +797,7 @@ void OpenCLGPUStream::init() {
     init.setArg(0, _envs[i].a());
     init.setArg(1, _envs[i].b());
     init.setArg(2, _envs[i].c());
-    init.setArg(3, cl_uint(myChunkLength));
+    init.setArg(3, cl_ulong(myChunkLength));
 
     queue.enqueueNDRangeKernel(init,
                                cl::NullRange,
@@ -221,61 +812,61 @@ void OpenCLGPUStream::init() {
   }
 }
 
-void OpenCLGPUStream::copy() {
-  size_t chunkLength = arrayLength() / devsCount();
-
+template <typename Ty>
+void OpenCLTypedStream<Ty>::copy() {
   for(unsigned i = 0, e = devsCount(); i != e; ++i) {
-    size_t myChunkLength = chunkLength;
-
-    if(i == e - 1)
-      myChunkLength += arrayLength() % devsCount();
+    size_t myChunkLength = chunkLength(i);
 
     cl::CommandQueue &queue = _envs[i].queue();
     cl::Kernel &copy = _envs[i].copy();
 
     copy.setArg(0, _envs[i].a());
     copy.setArg(1, _envs[i].c());
-    copy.setArg(2, cl_uint(myChunkLength));
+    copy.setArg(2, cl_ulong(myChunkLength));
 
     queue.enqueueNDRangeKernel(copy,
                                cl::NullRange,
                                _envs[i].copyGlobalWI(),
-                               _envs[i].copyLocalWI());
+                               _envs[i].copyLocalWI(),
+                               0,
+                               &_envs[i].event());
   }
-}
 
-void OpenCLGPUStream::scale(double k) {
-  size_t chunkLength = arrayLength() / devsCount();
+  // Kernels are timed one by one: wait for termination.
+  wait();
+  profile(Copy);
+}
 
+template <typename Ty>
+void OpenCLTypedStream<Ty>::scale(double k) {
   for(unsigned i = 0, e = devsCount(); i != e; ++i) {
-    size_t myChunkLength = chunkLength;
-
-    if(i == e - 1)
-      myChunkLength += arrayLength() % devsCount();
+    size_t myChunkLength = chunkLength(i);
 
     cl::CommandQueue &queue = _envs[i].queue();
     cl::Kernel &scale = _envs[i].scale();
 
     scale.setArg(0, _envs[i].b());
     scale.setArg(1, _envs[i].c());
-    scale.setArg(2, cl_double(k));
-    scale.setArg(3, cl_uint(myChunkLength));
+    scale.setArg(2, Ty(k));
+    scale.setArg(3, cl_ulong(myChunkLength));
 
     queue.enqueueNDRangeKernel(scale,
                                cl::NullRange,
                                _envs[i].scaleGlobalWI(),
-                               _envs[i].scaleLocalWI());
+                               _envs[i].scaleLocalWI(),
+                               0,
+                               &_envs[i].event());
   }
-}
 
-void OpenCLGPUStream::add() {
-  size_t chunkLength = arrayLength() / devsCount();
+  // Kernels are timed one by one: wait for termination.
+  wait();
+  profile(Scale);
+}
 
+template <typename Ty>
+void OpenCLTypedStream<Ty>::add() {
   for(unsigned i = 0, e = devsCount(); i != e; ++i) {
-    size_t myChunkLength = chunkLength;
-
-    if(i == e - 1)
-      myChunkLength += arrayLength() % devsCount();
+    size_t myChunkLength = chunkLength(i);
 
     cl::CommandQueue &queue = _envs[i].queue();
     cl::Kernel &add = _envs[i].add();
@@ -283,23 +874,25 @@ void OpenCLGPUStream::add() {
     add.setArg(0, _envs[i].a());
     add.setArg(1, _envs[i].b());
     add.setArg(2, _envs[i].c());
-    add.setArg(3, cl_uint(myChunkLength));
+    add.setArg(3, cl_ulong(myChunkLength));
 
     queue.enqueueNDRangeKernel(add,
                                cl::NullRange,
                                _envs[i].addGlobalWI(),
-                               _envs[i].addLocalWI());
+                               _envs[i].addLocalWI(),
+                               0,
+                               &_envs[i].event());
   }
-}
 
-void OpenCLGPUStream::triad(double k) {
-  size_t chunkLength = arrayLength() / devsCount();
+  // Kernels are timed one by one: wait for termination.
+  wait();
+  profile(Add);
+}
 
+template <typename Ty>
+void OpenCLTypedStream<Ty>::triad(double k) {
   for(unsigned i = 0, e = devsCount(); i != e; ++i) {
-    size_t myChunkLength = chunkLength;
-
-    if(i == e - 1)
-      myChunkLength += arrayLength() % devsCount();
+    size_t myChunkLength = chunkLength(i);
 
     cl::CommandQueue &queue = _envs[i].queue();
     cl::Kernel &triad = _envs[i].triad();
@@ -307,27 +900,137 @@ void OpenCLGPUStream::triad(double k) {
     triad.setArg(0, _envs[i].a());
     triad.setArg(1, _envs[i].b());
     triad.setArg(2, _envs[i].c());
-    triad.setArg(3, cl_double(k));
-    triad.setArg(4, cl_uint(myChunkLength));
+    triad.setArg(3, Ty(k));
+    triad.setArg(4, cl_ulong(myChunkLength));
 
     queue.enqueueNDRangeKernel(triad,
                                cl::NullRange,
                                _envs[i].triadGlobalWI(),
-                               _envs[i].triadLocalWI());
+                               _envs[i].triadLocalWI(),
+                               0,
+                               &_envs[i].event());
   }
 
-  // Triad is the last kernel: flush all queues just to be sure commands are
-  // moved to devices and wait for termination.
+  // Kernels are timed one by one: wait for termination.
+  wait();
+  profile(Triad);
+}
 
+template <typename Ty>
+void OpenCLTypedStream<Ty>::dot() {
   for(unsigned i = 0, e = devsCount(); i != e; ++i) {
+    size_t myChunkLength = chunkLength(i);
+
     cl::CommandQueue &queue = _envs[i].queue();
-    queue.flush();
+    cl::Kernel &dot = _envs[i].dot();
+
+    cl::NDRange &localWI = _envs[i].dotLocalWI();
+    unsigned arg = 0;
+
+    dot.setArg(arg++, _envs[i].a());
+    dot.setArg(arg++, _envs[i].b());
+    dot.setArg(arg++, _envs[i].sums());
+
+    // Sized work groups reduce their partial sums in local memory.
+    if(localWI.dimensions())
+      dot.setArg(arg++, localWI[0] * sizeof(Ty), 0);
+
+    dot.setArg(arg++, cl_ulong(myChunkLength));
+
+    queue.enqueueNDRangeKernel(dot,
+                               cl::NullRange,
+                               _envs[i].dotGlobalWI(),
+                               _envs[i].dotLocalWI(),
+                               0,
+                               &_envs[i].event());
   }
 
+  // Kernels are timed one by one: wait for termination. Partial sums are left
+  // on the devices, and reduced only at validation time.
+  wait();
+  profile(Dot);
+}
+
+template <typename Ty>
+void OpenCLTypedStream<Ty>::fill(double k) {
   for(unsigned i = 0, e = devsCount(); i != e; ++i) {
+    size_t myChunkLength = chunkLength(i);
+
     cl::CommandQueue &queue = _envs[i].queue();
-    queue.finish();
+    cl::Kernel &fill = _envs[i].fill();
+
+    fill.setArg(0, _envs[i].c());
+    fill.setArg(1, Ty(k));
+    fill.setArg(2, cl_ulong(myChunkLength));
+
+    queue.enqueueNDRangeKernel(fill,
+                               cl::NullRange,
+                               _envs[i].fillGlobalWI(),
+                               _envs[i].fillLocalWI(),
+                               0,
+                               &_envs[i].event());
   }
+
+  // Kernels are timed one by one: wait for termination.
+  wait();
+  profile(Fill);
 }
 
+//
+// OpenCLCPUStream implementation.
+//
+
+template <typename Ty>
+void OpenCLCPUStream<Ty>::iterationSpace(cl::Kernel &,
+                                         unsigned dev,
+                                         size_t length,
+                                         size_t &globalWI,
+                                         size_t &localWI) {
+  size_t width = this->vectorWidth(),
+         vectors = std::max<size_t>((length + width - 1) / width, 1);
+
+  // One chunk for each compute unit, but never less than a vector.
+  globalWI = std::min<size_t>(this->computeUnits(dev), vectors);
+  localWI = 0;
+}
+
+//
+// OpenCLGPUStream implementation.
+//
+
+template <typename Ty>
+std::vector<unsigned> OpenCLGPUStream<Ty>::vectorWidths() const {
+  return std::vector<unsigned>(TUNING_WIDTHS,
+                               TUNING_WIDTHS + TUNING_WIDTHS_COUNT);
+}
+
+template <typename Ty>
+cl::Kernel OpenCLGPUStream<Ty>::loadVariant(StreamBench::Kernel kernel,
+                                            unsigned width,
+                                            unsigned dev) {
+  std::ostringstream name;
+  name << "gpu_" << this->kernelTag(kernel);
+
+  if(width > 1)
+    name << width;
+
+  return this->load(name.str(), dev);
+}
+
+// Benchmarks are built for all the supported element types.
+template class florentino::OpenCLTypedStream<float>;
+template class florentino::OpenCLTypedStream<double>;
+template class florentino::OpenCLTypedStream<Int32>;
+template class florentino::OpenCLTypedStream<Int64>;
+
+template class florentino::OpenCLGPUStream<float>;
+template class florentino::OpenCLGPUStream<double>;
+template class florentino::OpenCLGPUStream<Int32>;
+template class florentino::OpenCLGPUStream<Int64>;
+
+template class florentino::OpenCLCPUStream<float>;
+template class florentino::OpenCLCPUStream<double>;
+template class florentino::OpenCLCPUStream<Int32>;
+template class florentino::OpenCLCPUStream<Int64>;
+
 #endif // HAVE_OPENCL
@@ -6,11 +6,14 @@
 
 #include "benchmarks.h"
 
+#include <map>
+
 namespace florentino {
 
 // Execute STREAM on an OpenCL device. Boilerplate code to setup the OpenCL
 // context and doing data transfer is defined in this class. Subclasses must
-// define and launch the actual STREAM kernels.
+// define and launch the actual STREAM kernels. Kernels are compiled for the
+// element type of the benchmark, given as an OpenCL C type.
 class OpenCLStream : public StreamBench,
                      public OpenCLAdapter {
 public:
@@ -25,16 +28,21 @@ public:
     BUFFER(a)
     BUFFER(b)
     BUFFER(c)
+    BUFFER(sums)
 
     #undef BUFFER
 
     void queue(const cl::CommandQueue &qeu) { _queue = qeu; }
 
-    #define KERNEL(N)                                           \
-    void N(cl::Kernel &kern, size_t globalWI, size_t localWI) { \
-      _ ## N = kern;                                            \
-      _ ## N ## GlobalWI = cl::NDRange(globalWI);               \
-      _ ## N ## LocalWI = cl::NDRange(localWI);                 \
+    // Event of the last timed kernel launched on the device.
+    cl::Event &event() { return _event; }
+
+    // Zero local work items leave the work group size to the runtime.
+    #define KERNEL(N)                                                       \
+    void N(cl::Kernel &kern, size_t globalWI, size_t localWI) {             \
+      _ ## N = kern;                                                        \
+      _ ## N ## GlobalWI = cl::NDRange(globalWI);                           \
+      _ ## N ## LocalWI = localWI ? cl::NDRange(localWI) : cl::NullRange;   \
     }
 
     KERNEL(init)
@@ -42,6 +50,8 @@ public:
     KERNEL(scale)
     KERNEL(add)
     KERNEL(triad)
+    KERNEL(dot)
+    KERNEL(fill)
 
     #undef KERNEL
 
@@ -58,6 +68,7 @@ public:
     BUFFER(a)
     BUFFER(b)
     BUFFER(c)
+    BUFFER(sums)
 
     #undef BUFFER
 
@@ -73,9 +84,20 @@ public:
     KERNEL(scale)
     KERNEL(add)
     KERNEL(triad)
+    KERNEL(dot)
+    KERNEL(fill)
 
     #undef KERNEL
 
+    // Partial sums computed by the dot kernel: one for each work group, or one
+    // for each work item if the work group size is left to the runtime.
+    size_t dotPartials() {
+      if(!_dotLocalWI.dimensions())
+        return _dotGlobalWI[0];
+
+      return _dotGlobalWI[0] / _dotLocalWI[0];
+    }
+
   private:
     #define BUFFER(N)  \
     cl::Buffer _ ## N;
@@ -83,10 +105,12 @@ public:
     BUFFER(a)
     BUFFER(b)
     BUFFER(c)
+    BUFFER(sums)
 
     #undef BUFFER
 
     cl::CommandQueue _queue;
+    cl::Event _event;
 
     #define KERNEL(N)               \
     cl::Kernel _ ## N;              \
@@ -98,47 +122,201 @@ public:
     KERNEL(scale)
     KERNEL(add)
     KERNEL(triad)
+    KERNEL(dot)
+    KERNEL(fill)
 
     #undef KERNEL
   };
 
+  // Configuration of a timed kernel on a device, searched by the autotuner: the
+  // width of the vectors processed by the kernel variant, the size of work
+  // groups, and the number of vectors processed by each work item.
+  class KernelConfig {
+  public:
+    KernelConfig(unsigned width = 1,
+                 size_t localWI = 0,
+                 size_t itemVectors = 1) : _width(width),
+                                           _localWI(localWI),
+                                           _itemVectors(itemVectors) { }
+
+  public:
+    unsigned width() const { return _width; }
+    size_t localWI() const { return _localWI; }
+    size_t itemVectors() const { return _itemVectors; }
+
+    // Map a kernel working on length elements with this configuration.
+    void iterationSpace(size_t length, size_t &globalWI, size_t &localWI) const;
+
+  private:
+    unsigned _width;
+    size_t _localWI;
+    size_t _itemVectors;
+  };
+
+  // How kernels have been configured on a device, when autotuning.
+  enum Tuning {
+    TuningCached,
+    TuningSearched
+  };
+
 protected:
   OpenCLStream(const std::string &nm,
                cl_device_type devType,
-               StreamBenchmarkRunner &runner)
-    : StreamBench(nm, runner),
-      _devType(devType) { }
+               StreamBenchmarkRunner &runner,
+               const char *elementType,
+               size_t elementBytes,
+               const char *openCLType)
+    : StreamBench(nm, runner, elementType, elementBytes),
+      _devType(devType),
+      _openCLType(openCLType) {
+    reserveDeviceClocks();
+  }
+
+public:
+  // Clocks recording the time spent on the devices by each kernel during a
+  // run. Device clocks are not synchronized with the host, so every run starts
+  // from ClkDevice, recorded as zero.
+  enum {
+    ClkDevice = ClkDot + 1,
+    ClkDeviceCopy,
+    ClkDeviceScale,
+    ClkDeviceAdd,
+    ClkDeviceTriad,
+    ClkDeviceDot,
+    ClkDeviceFill
+  };
 
 public:
   virtual void setup();
+  virtual void run();
   virtual void teardown();
 
 protected:
-  virtual cl::Kernel loadInit() = 0;
-  virtual cl::Kernel loadCopy() = 0;
-  virtual cl::Kernel loadScale() = 0;
-  virtual cl::Kernel loadAdd() = 0;
-  virtual cl::Kernel loadTriad() = 0;
+  virtual cl::Kernel loadInit(unsigned dev) = 0;
+  virtual cl::Kernel loadCopy(unsigned dev) = 0;
+  virtual cl::Kernel loadScale(unsigned dev) = 0;
+  virtual cl::Kernel loadAdd(unsigned dev) = 0;
+  virtual cl::Kernel loadTriad(unsigned dev) = 0;
+  virtual cl::Kernel loadDot(unsigned dev) = 0;
+  virtual cl::Kernel loadFill(unsigned dev) = 0;
 
-  virtual void check(double k);
+protected:
+  // Map a kernel working on length elements on the given device. By default,
+  // there is a work item for each element, in groups of a few times the
+  // preferred multiple of the device. Zero local work items leave the work
+  // group size to the runtime.
+  virtual void iterationSpace(cl::Kernel &kernel,
+                              unsigned dev,
+                              size_t length,
+                              size_t &globalWI,
+                              size_t &localWI);
+
+  // Vector kernels process vectors of this many elements: a cache line.
+  size_t vectorWidth() const { return 64 / elementBytes(); }
+
+  // Widths of the vector variants of timed kernels available to the autotuner,
+  // including 1 for the scalar kernels. By default, there are no variants, and
+  // kernels are not tuned.
+  virtual std::vector<unsigned> vectorWidths() const {
+    return std::vector<unsigned>();
+  }
+
+  // Load the variant of the given timed kernel working on vectors of the given
+  // width, one of vectorWidths(), for the given device.
+  virtual cl::Kernel loadVariant(Kernel kernel, unsigned width, unsigned dev);
+
+protected:
+  // Flush all queues, and wait for all enqueued commands to finish.
+  void wait();
+
+  // Account the time spent on the devices by the last launch of the given
+  // kernel, read from the events of the devices. Devices run concurrently, so
+  // the slowest one counts.
+  void profile(Kernel kernel);
+
+  // Read arrays from all the devices, for validation on the host.
+  template <typename Ty>
+  void readArrays(std::vector<Ty> &a, std::vector<Ty> &b, std::vector<Ty> &c);
+
+  // Elements of the arrays stored on the given device, and index of the first
+  // one in the whole arrays.
+  size_t chunkLength(unsigned dev) const { return _chunkLengths[dev]; }
+  size_t chunkOffset(unsigned dev) const { return _chunkOffsets[dev]; }
+
+private:
+  void reserveDeviceClocks();
+
+  // Split arrays among devices, proportionally to the bandwidth each of them
+  // reaches alone when copying a probe array. This way all devices finish at
+  // about the same time, instead of waiting for the slowest one.
+  void partition();
+
+  // Nanoseconds spent on the given device by the last timed kernel.
+  cl_ulong deviceTime(unsigned dev);
+
+  // Configure every timed kernel on every device, loading configurations saved
+  // by previous runs, or searching them. Programs built with different options
+  // are tuned separately.
+  void tune(const std::string &options);
+
+  // Time the candidate configurations of the given kernel, one after another,
+  // keeping the fastest on each device. All devices are tuned at the same
+  // time: devices without candidates keep their configuration.
+  typedef std::map<unsigned, cl::Kernel> KernelVariants;
+
+  // Variants are indexed by device, then by kernel.
+  void search(Kernel kernel,
+              std::vector<std::vector<KernelVariants> > &variants,
+              const std::vector<std::vector<KernelConfig> > &candidates);
+
+  void bind(Kernel kernel,
+            unsigned dev,
+            cl::Kernel &kern,
+            const KernelConfig &config);
+
+  std::string tuningPath(unsigned dev, const std::string &options);
+  bool loadTuning(unsigned dev,
+                  const std::string &path,
+                  std::vector<KernelVariants> &variants);
+  void storeTuning(unsigned dev, const std::string &path);
 
 protected:
   cl_device_type _devType;
+  const char *_openCLType;
   std::vector<Environment> _envs;
+
+private:
+  std::vector<size_t> _chunkLengths;
+  std::vector<size_t> _chunkOffsets;
+
+  // Bandwidth of each device when probed alone, in MB/s.
+  std::vector<double> _probeRates;
+
+  // Configuration of each timed kernel on each device, when autotuning.
+  std::vector<std::vector<KernelConfig> > _configs;
+  std::vector<Tuning> _tunings;
+
+  // Nanoseconds spent on the devices by each kernel during the current run.
+  cl_ulong _deviceTimes[KernelsCount];
 };
 
-// STREAM benchmark for OpenCL-enabled GPUs.
-class OpenCLGPUStream : public OpenCLStream {
+// Launch the STREAM kernels on arrays of Ty elements, on any kind of OpenCL
+// device. Subclasses select the device type and the kernels to launch.
+template <typename Ty>
+class OpenCLTypedStream : public OpenCLStream {
 public:
-  OpenCLGPUStream(StreamBenchmarkRunner &runner)
-    : OpenCLStream("OCL-GPU", CL_DEVICE_TYPE_GPU, runner) { }
+  typedef typename ElementTraits<Ty>::Accumulator Accumulator;
 
 protected:
-  virtual cl::Kernel loadInit() { return load("gpu_init"); }
-  virtual cl::Kernel loadCopy() { return load("gpu_copy"); }
-  virtual cl::Kernel loadScale() { return load("gpu_scale"); }
-  virtual cl::Kernel loadAdd() { return load("gpu_add"); }
-  virtual cl::Kernel loadTriad() { return load("gpu_triad"); }
+  OpenCLTypedStream(const std::string &nm,
+                    cl_device_type devType,
+                    StreamBenchmarkRunner &runner)
+    : OpenCLStream(nm,
+                   devType,
+                   runner,
+                   ElementTraits<Ty>::name(),
+                   sizeof(Ty),
+                   ElementTraits<Ty>::openCLName()) { }
 
 protected:
   virtual void init();
@@ -146,6 +324,95 @@ protected:
   virtual void scale(double k);
   virtual void add();
   virtual void triad(double k);
+  virtual void dot();
+  virtual void fill(double k);
+
+  virtual void check(double k);
+
+private:
+  // Result of the last dot, reduced from the partial sums left on the devices
+  // by the dot kernel.
+  Accumulator dotResult();
+};
+
+// STREAM benchmark for OpenCL-enabled GPUs, on arrays of Ty elements.
+template <typename Ty>
+class OpenCLGPUStream : public OpenCLTypedStream<Ty> {
+public:
+  OpenCLGPUStream(StreamBenchmarkRunner &runner)
+    : OpenCLTypedStream<Ty>("OCL-GPU", CL_DEVICE_TYPE_GPU, runner) { }
+
+protected:
+  virtual cl::Kernel loadInit(unsigned dev) {
+    return this->load("gpu_init", dev);
+  }
+  virtual cl::Kernel loadCopy(unsigned dev) {
+    return this->load("gpu_copy", dev);
+  }
+  virtual cl::Kernel loadScale(unsigned dev) {
+    return this->load("gpu_scale", dev);
+  }
+  virtual cl::Kernel loadAdd(unsigned dev) {
+    return this->load("gpu_add", dev);
+  }
+  virtual cl::Kernel loadTriad(unsigned dev) {
+    return this->load("gpu_triad", dev);
+  }
+  virtual cl::Kernel loadDot(unsigned dev) {
+    return this->load("gpu_dot", dev);
+  }
+  virtual cl::Kernel loadFill(unsigned dev) {
+    return this->load("gpu_fill", dev);
+  }
+
+  // Every kernel but init has variants on 2, 4, and 8 wide vectors, e.g.
+  // gpu_copy2 for gpu_copy.
+  virtual std::vector<unsigned> vectorWidths() const;
+  virtual cl::Kernel loadVariant(StreamBench::Kernel kernel,
+                                 unsigned width,
+                                 unsigned dev);
+};
+
+// STREAM benchmark for OpenCL CPU devices -- e.g. PoCL -- on arrays of Ty
+// elements, to be compared with CPUStream. Kernels are written as for CPU
+// threads: each work item streams a large contiguous chunk by vectors, and
+// there is a work item for each compute unit. Work groups do not share
+// anything, so their size is left to the runtime.
+template <typename Ty>
+class OpenCLCPUStream : public OpenCLTypedStream<Ty> {
+public:
+  OpenCLCPUStream(StreamBenchmarkRunner &runner)
+    : OpenCLTypedStream<Ty>("OCL-CPU", CL_DEVICE_TYPE_CPU, runner) { }
+
+protected:
+  virtual cl::Kernel loadInit(unsigned dev) {
+    return this->load("cpu_init", dev);
+  }
+  virtual cl::Kernel loadCopy(unsigned dev) {
+    return this->load("cpu_copy", dev);
+  }
+  virtual cl::Kernel loadScale(unsigned dev) {
+    return this->load("cpu_scale", dev);
+  }
+  virtual cl::Kernel loadAdd(unsigned dev) {
+    return this->load("cpu_add", dev);
+  }
+  virtual cl::Kernel loadTriad(unsigned dev) {
+    return this->load("cpu_triad", dev);
+  }
+  virtual cl::Kernel loadDot(unsigned dev) {
+    return this->load("cpu_dot", dev);
+  }
+  virtual cl::Kernel loadFill(unsigned dev) {
+    return this->load("cpu_fill", dev);
+  }
+
+protected:
+  virtual void iterationSpace(cl::Kernel &kernel,
+                              unsigned dev,
+                              size_t length,
+                              size_t &globalWI,
+                              size_t &localWI);
 };
 
 } // End namespace florentino.